@@ -0,0 +1,113 @@
+#include "RawCapture.hpp"
+
+
+
+RawCapture::RawCapture()
+    : head(0)
+    , count(0)
+    , batch(0)
+    , hex(false)
+    , dropped(0)
+{
+}
+
+void RawCapture::SetBatch(size_t frames)
+{
+    batch = (MAX_FRAMES < frames) ? MAX_FRAMES : frames;
+    if (batch == 0) {
+        head = 0;
+        count = 0;
+    }
+}
+
+void RawCapture::SetHex(bool h)
+{
+    hex = h;
+}
+
+bool RawCapture::IsEnabled() const
+{
+    return 0 < batch;
+}
+
+void RawCapture::Add(unsigned long now, Direction dir, const Message& msg)
+{
+    Add(now, dir, msg.GetData(), msg.GetLength());
+}
+
+void RawCapture::Add(unsigned long now, Direction dir, const uint8_t* data, size_t len)
+{
+    if (batch == 0) {
+        return;
+    }
+    if (count == MAX_FRAMES) {
+        head = (head + 1) % MAX_FRAMES;
+        count--;
+        dropped++;
+    }
+    Frame& f = frames[(head + count) % MAX_FRAMES];
+    f.time = now;
+    f.dir = dir;
+    f.length = (MAX_FRAME_LEN < len) ? MAX_FRAME_LEN : len;
+    memcpy(f.data, data, f.length);
+    count++;
+}
+
+bool RawCapture::IsBatchReady() const
+{
+    return (0 < batch) && (batch <= count);
+}
+
+size_t RawCapture::GetCount() const
+{
+    return count;
+}
+
+uint32_t RawCapture::GetDropped() const
+{
+    return dropped;
+}
+
+size_t RawCapture::WriteFrame(const Frame& f, uint8_t* buf, size_t len) const
+{
+    if (hex) {
+        char line[MAX_HEX_LEN];
+        int n = snprintf(line, sizeof(line), "%lu %c ", (unsigned long)f.time, f.dir);
+        char* p = Message::AppendHex(line + n, f.data, f.length);
+        *p++ = '\n';
+        size_t size = p - line;
+        if (len < size) {
+            return 0;
+        }
+        memcpy(buf, line, size);
+        return size;
+    }
+
+    size_t size = 6 + f.length;
+    if (len < size) {
+        return 0;
+    }
+    buf[0] = f.time >> 24;
+    buf[1] = f.time >> 16;
+    buf[2] = f.time >> 8;
+    buf[3] = f.time;
+    buf[4] = f.dir;
+    buf[5] = f.length;
+    memcpy(buf + 6, f.data, f.length);
+    return size;
+}
+
+size_t RawCapture::Write(uint8_t* buf, size_t len)
+{
+    size_t written = 0;
+    while (0 < count) {
+        size_t n = WriteFrame(frames[head], buf + written, len - written);
+        if (n == 0) {
+            break;
+        }
+        written += n;
+        head = (head + 1) % MAX_FRAMES;
+        count--;
+    }
+    return written;
+}
@@ -0,0 +1,58 @@
+#ifndef _RAWCAPTURE_HPP_
+#define _RAWCAPTURE_HPP_
+
+#include <Arduino.h>
+#include "Message.hpp"
+
+
+// records the raw frames with their time into a ring buffer. the frames are published
+// in batches with a single message instead of one raw/in or raw/out message per frame.
+// if the ring is full the oldest frame is dropped.
+//   binary: <time ms, 4 bytes big endian> <'i' or 'o'> <length> <bytes of the frame>
+//   hex:    <time ms> <i or o> <frame as hex>\n
+class RawCapture
+{
+    public:
+
+        static const size_t MAX_FRAMES = 32;
+        static const size_t MAX_FRAME_LEN = 20;     // longer frames are cut off
+        static const size_t MAX_HEX_LEN = 10 + 3 + 2 * MAX_FRAME_LEN + 1;
+
+        enum Direction { Dir_In = 'i', Dir_Out = 'o' };
+
+        RawCapture();
+
+        void SetBatch(size_t frames);   // frames per message, 0 = off
+        void SetHex(bool hex);
+        bool IsEnabled() const;
+
+        void Add(unsigned long now, Direction dir, const Message& msg);
+        void Add(unsigned long now, Direction dir, const uint8_t* data, size_t len);
+        bool IsBatchReady() const;
+        size_t GetCount() const;
+        uint32_t GetDropped() const;
+
+        // writes the oldest frames that fit into buf and removes them, 0 if none fits
+        size_t Write(uint8_t* buf, size_t len);
+
+    private:
+
+        struct Frame
+        {
+            uint32_t time;
+            uint8_t  dir;
+            uint8_t  length;
+            uint8_t  data[MAX_FRAME_LEN];
+        };
+
+        size_t WriteFrame(const Frame& f, uint8_t* buf, size_t len) const;
+
+        Frame    frames[MAX_FRAMES];
+        size_t   head;      // the oldest frame
+        size_t   count;
+        size_t   batch;
+        bool     hex;
+        uint32_t dropped;
+};
+
+#endif // _RAWCAPTURE_HPP_
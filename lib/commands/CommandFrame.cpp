@@ -0,0 +1,26 @@
+#include "CommandFrame.hpp"
+#include "Message.hpp"
+#include "Logger.hpp"
+
+
+
+bool CommandFrame::Send(Stream& stream) const
+{
+    size_t num = stream.write(bytes, LENGTH);
+
+    if (num < LENGTH) {
+        LOGE("not enough data written");
+        return false;
+    }
+    return true;
+}
+
+size_t CommandFrame::WriteHex(char* buf, size_t len) const
+{
+    if (len <= 2 * LENGTH) {
+        return 0;
+    }
+    char* end = Message::AppendHex(buf, bytes, LENGTH);
+    *end = '\0';
+    return end - buf;
+}
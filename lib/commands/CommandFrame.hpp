@@ -0,0 +1,20 @@
+#ifndef _COMMANDFRAME_HPP_
+#define _COMMANDFRAME_HPP_
+
+#include <Arduino.h>
+
+
+// a command encoded into its final wire frame: start tag, command, 3 values, crc, end tag.
+// it is plain data, a copy is a memcpy and it is sent without encoding it again.
+struct CommandFrame
+{
+    static const size_t LENGTH = 10;
+
+    uint8_t bytes[LENGTH];
+
+    uint8_t GetCommand() const { return bytes[1]; }
+    bool Send(Stream& stream) const;
+    size_t WriteHex(char* buf, size_t len) const;  // 0 if buf is too small
+};
+
+#endif // _COMMANDFRAME_HPP_
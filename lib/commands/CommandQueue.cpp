@@ -0,0 +1,132 @@
+#include "CommandQueue.hpp"
+#include "Logger.hpp"
+
+
+CommandQueue::CommandQueue()
+    : count(0), pushed(0), merged(0), dropped(0), highWater(0)
+{
+}
+
+bool CommandQueue::Push(const CommandFrame& cmd, Priority priority)
+{
+    pushed++;
+
+    // coalesce: the newer command of the same kind supersedes the queued one
+    for (size_t i = 0; i < count; i++) {
+        if (entries[i].command.GetCommand() == cmd.GetCommand()) {
+            DLOGD("command 0x%02x merged into queued command", cmd.GetCommand());
+            if (priority < entries[i].priority) {
+                priority = entries[i].priority;
+            }
+            merged++;
+            Remove(i);
+            break; // for
+        }
+    }
+
+    // a stop makes all queued commands of lower priority obsolete
+    if (priority == Priority_Stop) {
+        for (size_t i = count; 0 < i; --i) {
+            if (entries[i-1].priority < Priority_Stop) {
+                DLOGD("command 0x%02x dropped by stop", entries[i-1].command.GetCommand());
+                dropped++;
+                Remove(i-1);
+            }
+        }
+    }
+
+    if (CAPACITY <= count) {
+        // the last entry has the lowest priority and is the newest of it
+        if (entries[count-1].priority < priority) {
+            DLOGE("command queue full, dropped command 0x%02x", entries[count-1].command.GetCommand());
+            dropped++;
+            Remove(count-1);
+        } else {
+            DLOGE("command queue full, dropped command 0x%02x", cmd.GetCommand());
+            dropped++;
+            return false;
+        }
+    }
+
+    Insert(cmd, priority);
+    return true;
+}
+
+bool CommandQueue::Pop(CommandFrame& cmd)
+{
+    if (count == 0) {
+        return false;
+    }
+    cmd = entries[0].command;
+    Remove(0);
+    return true;
+}
+
+void CommandQueue::Clear()
+{
+    count = 0;
+}
+
+bool CommandQueue::IsEmpty() const
+{
+    return count == 0;
+}
+
+size_t CommandQueue::Size() const
+{
+    return count;
+}
+
+uint32_t CommandQueue::GetPushed() const
+{
+    return pushed;
+}
+
+uint32_t CommandQueue::GetMerged() const
+{
+    return merged;
+}
+
+uint32_t CommandQueue::GetDropped() const
+{
+    return dropped;
+}
+
+size_t CommandQueue::GetHighWater() const
+{
+    return highWater;
+}
+
+void CommandQueue::WriteStatsJson(StringBuilder& json) const
+{
+    json << F("{\"pushed\":") << pushed
+        << F(",\"merged\":") << merged
+        << F(",\"dropped\":") << dropped
+        << F(",\"highWater\":") << highWater << '}';
+}
+
+void CommandQueue::Remove(size_t index)
+{
+    for (size_t i = index; i + 1 < count; i++) {
+        entries[i] = entries[i+1];
+    }
+    count--;
+}
+
+void CommandQueue::Insert(const CommandFrame& cmd, Priority priority)
+{
+    // behind all entries with the same or a higher priority
+    size_t pos = 0;
+    while (pos < count && priority <= entries[pos].priority) {
+        pos++;
+    }
+    for (size_t i = count; pos < i; --i) {
+        entries[i] = entries[i-1];
+    }
+    entries[pos].command = cmd;
+    entries[pos].priority = priority;
+    count++;
+    if (highWater < count) {
+        highWater = count;
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef _COMMANDQUEUE_HPP_
+#define _COMMANDQUEUE_HPP_
+
+#include <Arduino.h>
+#include "CommandFrame.hpp"
+#include "StringBuilder.hpp"
+
+
+// small bounded queue of encoded commands waiting to be send to the charger.
+// entries are ordered by priority (stop > start > set-point) and by arrival within a
+// priority. a newer command supersedes a queued one of the same kind (coalescing), a
+// stop supersedes all queued commands of lower priority.
+class CommandQueue
+{
+    public:
+
+        enum Priority { Priority_SetPoint, Priority_Start, Priority_Stop };
+
+        static const size_t CAPACITY = 4;
+
+        CommandQueue();
+
+        bool Push(const CommandFrame& cmd, Priority priority);
+        bool Pop(CommandFrame& cmd);
+        void Clear();
+
+        bool IsEmpty() const;
+        size_t Size() const;
+
+        uint32_t GetPushed() const;
+        uint32_t GetMerged() const;
+        uint32_t GetDropped() const;
+        size_t GetHighWater() const;
+        void WriteStatsJson(StringBuilder& json) const;
+
+    private:
+
+        struct Entry
+        {
+            CommandFrame command;
+            Priority     priority;
+        };
+
+        Entry    entries[CAPACITY];
+        size_t   count;
+
+        uint32_t pushed;
+        uint32_t merged;
+        uint32_t dropped;
+        size_t   highWater;
+
+        void Remove(size_t index);
+        void Insert(const CommandFrame& cmd, Priority priority);
+};
+
+#endif // _COMMANDQUEUE_HPP_
@@ -161,53 +161,111 @@ std::vector<Parameter> EbcA20::GetCommandParameters(Command_t cmd) const
     }
 }
 
-std::vector<Parameter> EbcA20::GetResponseParameters(Mode_t responseMode) const
+// value 3 is unknown
+static const ParameterDescriptor D_CC_RESPONSE[] = {
+    PARAMETER_DESCRIPTOR(0, currentA, PP_A),
+    PARAMETER_DESCRIPTOR(1, voltageV, PP_V),
+    PARAMETER_DESCRIPTOR(2, capacityAh, PP_Ah),
+    PARAMETER_DESCRIPTOR(4, currentSetA, PP_A_set),
+    PARAMETER_DESCRIPTOR(5, voltageSetV, PP_V_set),
+    PARAMETER_DESCRIPTOR(6, maxTimeM, PP_T),
+};
+
+static const ParameterDescriptor D_CP_RESPONSE[] = {
+    PARAMETER_DESCRIPTOR(0, currentA, PP_A),
+    PARAMETER_DESCRIPTOR(1, voltageV, PP_V),
+    PARAMETER_DESCRIPTOR(2, capacityAh, PP_Ah),
+    PARAMETER_DESCRIPTOR(4, powerSetW, PP_P),
+    PARAMETER_DESCRIPTOR(5, voltageSetV, PP_V_set),
+    PARAMETER_DESCRIPTOR(6, maxTimeSetM, PP_T),
+};
+
+static const ParameterDescriptor C_CV_RESPONSE[] = {
+    PARAMETER_DESCRIPTOR(0, currentA, PP_A),
+    PARAMETER_DESCRIPTOR(1, voltageV, PP_V),
+    PARAMETER_DESCRIPTOR(2, capacityAh, PP_Ah),
+    PARAMETER_DESCRIPTOR(4, currentSetA, PP_A_set),
+    PARAMETER_DESCRIPTOR(5, voltageSetV, PP_V_set),
+    PARAMETER_DESCRIPTOR(6, cutoffA, PP_A),
+};
+
+size_t EbcA20::GetResponseDescriptors(Mode_t responseMode, const ParameterDescriptor*& descriptors) const
 {
     switch (responseMode)
     {
     case D_CC_ACTIVE:
     case D_CC_STOPPED:
     case D_CC_FINISHED:
-        return vector<Parameter> {
-            Parameter(0, ParameterName::currentA, ParameterPacking::PP_A),
-            Parameter(1, ParameterName::voltageV, ParameterPacking::PP_V),
-            Parameter(2, ParameterName::capacityAh, ParameterPacking::PP_Ah),
-            // Parameter(3, ParameterName::unknown, ParameterPacking::PP_None),
-            Parameter(4, ParameterName::currentSetA, ParameterPacking::PP_A_set),
-            Parameter(5, ParameterName::voltageSetV, ParameterPacking::PP_V_set),
-            Parameter(6, ParameterName::maxTimeM, ParameterPacking::PP_T),
-        };
+        descriptors = D_CC_RESPONSE;
+        return sizeof(D_CC_RESPONSE) / sizeof(D_CC_RESPONSE[0]);
     case D_CP_ACTIVE:
     case D_CP_STOPPED:
     case D_CP_FINISHED:
-        return vector<Parameter> {
-            Parameter(0, ParameterName::currentA, ParameterPacking::PP_A),
-            Parameter(1, ParameterName::voltageV, ParameterPacking::PP_V),
-            Parameter(2, ParameterName::capacityAh, ParameterPacking::PP_Ah),
-            // Parameter(3, ParameterName::unknown, ParameterPacking::PP_None),
-            Parameter(4, ParameterName::powerSetW, ParameterPacking::PP_P),
-            Parameter(5, ParameterName::voltageSetV, ParameterPacking::PP_V_set),
-            Parameter(6, ParameterName::maxTimeSetM, ParameterPacking::PP_T),
-        };
+        descriptors = D_CP_RESPONSE;
+        return sizeof(D_CP_RESPONSE) / sizeof(D_CP_RESPONSE[0]);
     case C_CV_ACTIVE:
     case C_CV_STOPPED:
     case C_CV_FINISHED:
-        return vector<Parameter> {
-            Parameter(0, ParameterName::currentA, ParameterPacking::PP_A),
-            Parameter(1, ParameterName::voltageV, ParameterPacking::PP_V),
-            Parameter(2, ParameterName::capacityAh, ParameterPacking::PP_Ah),
-            // Parameter(3, ParameterName::unknown, ParameterPacking::PP_None),
-            Parameter(4, ParameterName::currentSetA, ParameterPacking::PP_A_set),
-            Parameter(5, ParameterName::voltageSetV, ParameterPacking::PP_V_set),
-            Parameter(6, ParameterName::cutoffA, ParameterPacking::PP_A),
-        };
-    
+        descriptors = C_CV_RESPONSE;
+        return sizeof(C_CV_RESPONSE) / sizeof(C_CV_RESPONSE[0]);
+
     default:
-        return vector<Parameter>();
+        descriptors = C_CV_RESPONSE;    // a known mode without parameters
+        return 0;
+    }
+}
+
+std::vector<Parameter> EbcA20::GetResponseParameters(Mode_t responseMode) const
+{
+    const ParameterDescriptor* descriptors = nullptr;
+    size_t num = GetResponseDescriptors(responseMode, descriptors);
+    vector<Parameter> parameters;
+    parameters.reserve(num);
+    for (size_t i = 0; i < num; ++i) {
+        parameters.push_back(Parameter(descriptors[i].index, descriptors[i].name, descriptors[i].packing));
     }
+    return parameters;
 }
 
 // only used by response messages
+// same as Decode(), but in integers: the 16 bit source is a base 240 number
+bool EbcA20::DecodeMilli(uint16_t source, int32_t& out, ParameterPacking pp) const
+{
+    int32_t raw = ((source >> 8) * 240) + (source & 0xFF);
+    switch (pp)
+    {
+    case PP_V:
+        out = raw;
+        break;
+    case PP_Ah:
+        if (source & 0x8000) {
+            if ((source & 0xE000) == 0xE000) {
+                out = ((((source >> 8) & 0x3F) * 240) + (source & 0xFF) - 0x1C00) * 100;
+            } else {
+                out = ((((source >> 8) & 0x7F) * 240) + (source & 0xFF) - 0x0800) * 10;
+            }
+        } else {
+            out = raw;
+        }
+        break;
+    case PP_V_set:
+    case PP_A_set:
+    case PP_A:
+        out = raw * 10;
+        break;
+    case PP_T:
+    case PP_P:
+        out = (int32_t)source * 1000;
+        break;
+    case PP_None:
+        out = 0;
+        break;
+    default:
+        return false;
+    }
+    return true;
+}
+
 bool EbcA20::Decode(uint16_t source, double& value, ParameterPacking pp) const
 {
     switch (pp) // PP_None, PP_V, PP_V_set, PP_A, PP_A_set, PP_P, PP_T, PP_Ah
@@ -12,6 +12,7 @@ class EbcA20 : public EbcController
         virtual const char *GetModel() const;
         virtual std::vector<Parameter> GetCommandParameters(Command_t cmd) const;
         virtual std::vector<Parameter> GetResponseParameters(Mode_t responseMode) const;
+        virtual size_t GetResponseDescriptors(Mode_t responseMode, const ParameterDescriptor*& descriptors) const;
         virtual const char* ModeAsString() const;
         virtual const char* CommandToString(Command_t cmd) const;
         virtual bool ModeIsActive() const;
@@ -19,6 +20,7 @@ class EbcA20 : public EbcController
         virtual bool ModeIsFinished() const;
         virtual bool Decode(uint16_t source, double& out, ParameterPacking pp) const;
         virtual bool Encode(double source, uint16_t& out, ParameterPacking pp) const;
+        virtual bool DecodeMilli(uint16_t source, int32_t& out, ParameterPacking pp) const;
 
 };
 
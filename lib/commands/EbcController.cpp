@@ -6,6 +6,7 @@
 #include "EbcA20.hpp"
 #include "EbcUnknown.hpp"
 #include "Logger.hpp"
+#include "Profiler.hpp"
 
 using namespace std;
 
@@ -45,6 +46,7 @@ EbcController& EbcController::GetController(uint8_t id)
 
 EbcController& EbcController::GetController(const Response& response)
 {
+    PROFILE_SCOPE(Prof_Decode);
     EbcController& controller = GetController(response.GetId());
     controller.SetData(response.GetData(), response.mode);
     return controller;
@@ -112,6 +114,25 @@ bool EbcController::IsStoppedResponseForCommand(Command_t cmd) const
     return false;
 }
 
+// the first response that shows the charger has taken over the command.
+// commands with an active mode (C-CV, D-CC, ...) are acknowledged by the active or
+// finished mode, a stopped mode might be the state before the command was received.
+bool EbcController::IsAckResponseForCommand(Command_t cmd) const
+{
+    for (auto & c : commands)
+    {
+        if (c.command == cmd)
+        {
+            if (c.active == Response::InvalidMode) {
+                return IsValidResponseForCommand(cmd);
+            }
+            // not the finish mode: it may be left from the last run of the same command
+            return c.active == mode;
+        }
+    }
+    return false;
+}
+
 bool EbcController::IsValidData() const
 {
     for (auto & c : commands)
@@ -184,6 +205,11 @@ Command EbcController::CreateStop() const
     return Command(this, Cmd_Stop);
 }
 
+bool EbcController::IsStopCommand(Command_t cmd) const
+{
+    return cmd == Cmd_Stop;
+}
+
 Command EbcController::CreateCommand(Command_t c, const vector<Parameter>& parameters) const
 {
     auto cmds = GetCommands();
@@ -196,28 +222,28 @@ Command EbcController::CreateCommand(Command_t c, const vector<Parameter>& param
     }
 
     if (!found) {
-        Logger::LogE(String(F("command 0x")) + String(c, HEX) + F(" is not defined on controller ") + GetModel());
+        DLOGE("command 0x%x is not defined on controller %s", (unsigned)c, GetModel());
         return Command(); // Invalid
     }
 
     const vector<Parameter> params = GetCommandParameters(c);
     if (params.size() != parameters.size()) {
-        Logger::LogE(String(F("command ")) + String(CommandToString(c)) + F(": parameter sizes do not match"));
+        DLOGE("command %s: parameter sizes do not match", CommandToString(c));
         return Command(); // Invalid
     }
 
     for (auto itA = params.begin(), itB = parameters.begin(); (itA != params.end()) && (itB != parameters.end()); ++itA, ++itB)
     {
         if (itA->index != itB->index) {
-            Logger::LogE(String(F("command ")) + String(CommandToString(c)) + F(": parameter index do not match"));
+            DLOGE("command %s: parameter index do not match", CommandToString(c));
             return Command(); // Invalid
         }
         if (itA->name != itB->name) {
-            Logger::LogE(String(F("command ")) + String(CommandToString(c)) + F(": parameter name do not match"));
+            DLOGE("command %s: parameter name do not match", CommandToString(c));
             return Command(); // Invalid
         }
         if (itA->packing != itB->packing) {
-            Logger::LogE(String(F("command ")) + String(CommandToString(c)) + F(": parameter packing do not match"));
+            DLOGE("command %s: parameter packing do not match", CommandToString(c));
             return Command(); // Invalid
         }
     }
@@ -249,7 +275,7 @@ Command EbcController::CreateCommand(JsonObject& jsonObj) const
             p.value = jparameters[p.name];
         } else {
             if (p.mandatory) {
-                Logger::LogE(String(F("command ")) + String(CommandToString(cmd)) + F(": parameter not found in json object: ") + p.name);
+                DLOGE("command %s: parameter not found in json object: %s", CommandToString(cmd), ParameterName::Find(p.name));
                 return Command(); // Invalid
             }
         }
@@ -265,7 +291,7 @@ Command EbcController::CreateCommand(const String& jsonCommand)
     DeserializationError error = deserializeJson(doc, jsonCommand);
 
     if (error) {
-        Logger::LogE(String(F("deserializeJson() failed: ")) + String(error.f_str()));
+        DLOGE("deserializeJson() failed: %s", error.c_str());
         return Command(); // Invalid
     }
 
@@ -275,23 +301,47 @@ Command EbcController::CreateCommand(const String& jsonCommand)
 
 std::vector<Parameter> EbcController::GetResponseParameters() const
 {
+    PROFILE_SCOPE(Prof_Parameters);
     std::vector<Parameter> parameters = GetResponseParameters(mode);
 
     for (auto& p : parameters) {
         if (p.index < 0 || value.size() <= p.index) {
-            Logger::LogE(String(F("parameter ")) + p.name + F(" not in range of values of response message 0x") + String(mode, HEX));
+            DLOGE("parameter %s not in range of values of response message 0x%02x", ParameterName::Find(p.name), (unsigned)mode);
             continue; // skip this parameter, because it is not valid
         }
         p.source = value[p.index];
 
         if (!Decode(p.source, p.value, p.packing)) {
-            Logger::LogE(String(F("there is no decoder for parameter ")) + p.name + F(" in response message 0x") + String(mode, HEX));
+            DLOGE("there is no decoder for parameter %s in response message 0x%02x", ParameterName::Find(p.name), (unsigned)mode);
         }
     }
 
     return parameters;
 }
 
+bool EbcController::GetResponseValue(const char* name, double& out) const
+{
+    const ParameterDescriptor* descriptors = nullptr;
+    size_t num = GetResponseDescriptors(mode, descriptors);
+    if (descriptors == nullptr) {
+        for (auto & p : GetResponseParameters()) {
+            if (p.name == name) {
+                out = p.value;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    for (size_t i = 0; i < num; ++i) {
+        const ParameterDescriptor& d = descriptors[i];
+        if (strcmp(d.name, name) == 0) {
+            return (d.packing != PP_None) && (d.index < value.size()) && Decode(value[d.index], out, d.packing);
+        }
+    }
+    return false;
+}
+
 /* e.g.
 {
   "mode": "C-CV (active)",
@@ -306,6 +356,12 @@ std::vector<Parameter> EbcController::GetResponseParameters() const
 
 String EbcController::GetResponseJson() const
 {
+    char json[256];    // the size check of WriteResponseJson() assumes the longest values
+    if (0 < WriteResponseJson(json, sizeof(json))) {
+        return String(json);
+    }
+
+    PROFILE_SCOPE(Prof_Json);   // includes Prof_Parameters
     StaticJsonDocument<192> doc;
 
     JsonObject root = doc.to<JsonObject>();
@@ -322,4 +378,163 @@ String EbcController::GetResponseJson() const
     String output;
     serializeJson(doc, output);
     return output;
+}
+
+size_t EbcController::GetResponseDescriptors(Mode_t responseMode, const ParameterDescriptor*& descriptors) const
+{
+    descriptors = nullptr;
+    return 0;   // no descriptor table, GetResponseJson() falls back to ArduinoJson
+}
+
+bool EbcController::DecodeMilli(uint16_t source, int32_t& out, ParameterPacking pp) const
+{
+    double value = 0.0;
+    if (!Decode(source, value, pp)) {
+        return false;
+    }
+    out = lround(value * 1000.0);
+    return true;
+}
+
+// appends a value in 1/1000 like ArduinoJson prints a double: no trailing zeros (4200 -> 4.2)
+static char* AppendMilli(char* p, int32_t milli)
+{
+    uint32_t a = (milli < 0) ? (uint32_t)(-(int64_t)milli) : (uint32_t)milli;
+    if (milli < 0) {
+        *p++ = '-';
+    }
+    uint32_t whole = a / 1000;
+    uint32_t fraction = a % 1000;
+    char digits[10];
+    size_t n = 0;
+    do {
+        digits[n++] = '0' + (whole % 10);
+        whole /= 10;
+    } while (0 < whole);
+    while (0 < n) {
+        *p++ = digits[--n];
+    }
+    if (0 < fraction) {
+        *p++ = '.';
+        for (uint32_t div = 100; (0 < div) && (0 < fraction); div /= 10) {
+            *p++ = '0' + (fraction / div);
+            fraction %= div;
+        }
+    }
+    return p;
+}
+
+static char* AppendString(char* p, const char* s)
+{
+    while (*s != '\0') {
+        *p++ = *s++;
+    }
+    return p;
+}
+
+// {"mode":"C-CV (active)","parameters":{"currentA":0.355,"voltageV":3.961}}
+size_t EbcController::WriteResponseJson(char* buf, size_t len) const
+{
+    PROFILE_SCOPE(Prof_Json);
+    const ParameterDescriptor* descriptors = nullptr;
+    size_t num = GetResponseDescriptors(mode, descriptors);
+    if (descriptors == nullptr) {
+        return 0;
+    }
+
+    static const size_t MAX_VALUE_LEN = 13;    // -2147483.648
+    const char* modeStr = ModeAsString();
+    size_t need = 9 + strlen(modeStr) + 17 + 3;  // {"mode":"...","parameters":{...}} + '\0'
+    for (size_t i = 0; i < num; ++i) {
+        need += 1 + strlen(descriptors[i].key) + MAX_VALUE_LEN;
+    }
+    if (len < need) {
+        return 0;
+    }
+
+    char* p = AppendString(buf, "{\"mode\":\"");
+    p = AppendString(p, modeStr);
+    p = AppendString(p, "\",\"parameters\":{");
+    bool first = true;
+    for (size_t i = 0; i < num; ++i) {
+        const ParameterDescriptor& d = descriptors[i];
+        int32_t milli = 0;
+        if ((d.packing == PP_None) || (value.size() <= d.index) || !DecodeMilli(value[d.index], milli, d.packing)) {
+            continue;
+        }
+        if (!first) {
+            *p++ = ',';
+        }
+        first = false;
+        p = AppendString(p, d.key);
+        p = AppendMilli(p, milli);
+    }
+    p = AppendString(p, "}}");
+    *p = '\0';
+    return p - buf;
+}
+
+static uint8_t* AppendMsgPackString(uint8_t* p, const char* s)
+{
+    size_t n = strlen(s);
+    if (n < 32) {
+        *p++ = 0xa0 | n;            // fixstr
+    } else {
+        *p++ = 0xd9;                // str 8
+        *p++ = (uint8_t) n;
+    }
+    memcpy(p, s, n);
+    return p + n;
+}
+
+// {"mode":"C-CV (active)","parameters":{"currentA":0.355,"voltageV":3.961}} with float32 values
+size_t EbcController::WriteResponseMsgPack(uint8_t* buf, size_t len) const
+{
+    const ParameterDescriptor* descriptors = nullptr;
+    size_t num = GetResponseDescriptors(mode, descriptors);
+    if ((descriptors == nullptr) || (15 < num)) {
+        return 0;
+    }
+
+    const char* modeStr = ModeAsString();
+    size_t need = 1 + 5 + 2 + strlen(modeStr) + 11 + 1;
+    for (size_t i = 0; i < num; ++i) {
+        need += 2 + strlen(descriptors[i].name) + 5;
+    }
+    if ((len < need) || (255 < strlen(modeStr))) {
+        return 0;
+    }
+
+    int32_t milli[15];
+    bool valid[15];
+    size_t numValid = 0;
+    for (size_t i = 0; i < num; ++i) {
+        const ParameterDescriptor& d = descriptors[i];
+        valid[i] = (d.packing != PP_None) && (d.index < value.size()) && DecodeMilli(value[d.index], milli[i], d.packing);
+        if (valid[i]) {
+            numValid++;
+        }
+    }
+
+    uint8_t* p = buf;
+    *p++ = 0x82;                    // fixmap, 2 entries
+    p = AppendMsgPackString(p, "mode");
+    p = AppendMsgPackString(p, modeStr);
+    p = AppendMsgPackString(p, "parameters");
+    *p++ = 0x80 | numValid;
+    for (size_t i = 0; i < num; ++i) {
+        if (!valid[i]) {
+            continue;
+        }
+        p = AppendMsgPackString(p, descriptors[i].name);
+        float f = milli[i] / 1000.0f;
+        uint32_t bits;
+        memcpy(&bits, &f, sizeof(bits));
+        *p++ = 0xca;                // float 32, big endian
+        *p++ = bits >> 24;
+        *p++ = bits >> 16;
+        *p++ = bits >> 8;
+        *p++ = bits;
+    }
+    return p - buf;
 }
\ No newline at end of file
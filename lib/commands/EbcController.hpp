@@ -46,11 +46,13 @@ class EbcController
 
         virtual bool Decode(uint16_t source, double& out, ParameterPacking pp) const = 0;
         virtual bool Encode(double source, uint16_t& out, ParameterPacking pp) const = 0;
+        virtual bool DecodeMilli(uint16_t source, int32_t& out, ParameterPacking pp) const;     // in 1/1000 of the unit
 
 
         Command CreateConnect() const;
         Command CreateDisconnect() const;
         Command CreateStop() const;
+        bool IsStopCommand(Command_t cmd) const;
 
         Command CreateCommand(Command_t cmd, const std::vector<Parameter>& parameters) const;
         Command CreateCommand(JsonObject& jsonObj) const;
@@ -63,12 +65,17 @@ class EbcController
         std::vector<Mode_t> GetResponses() const;
         virtual std::vector<Parameter> GetResponseParameters(Mode_t responseMode) const = 0;
         std::vector<Parameter> GetResponseParameters() const;
+        bool GetResponseValue(const char* name, double& out) const;    // one parameter of the last response, without a vector
+        virtual size_t GetResponseDescriptors(Mode_t responseMode, const ParameterDescriptor*& descriptors) const;
         String GetResponseJson() const;
+        size_t WriteResponseJson(char* buf, size_t len) const;     // same as GetResponseJson(), 0 if buf is too small
+        size_t WriteResponseMsgPack(uint8_t* buf, size_t len) const;   // same content as MessagePack, 0 if buf is too small
 
         bool IsValidResponseForCommand(Command_t cmd) const;
         bool IsActiveResponseForCommand(Command_t cmd) const;
         bool IsFinishedResponseForCommand(Command_t cmd) const;
         bool IsStoppedResponseForCommand(Command_t cmd) const;
+        bool IsAckResponseForCommand(Command_t cmd) const;
         bool IsValidData() const;
 
         static EbcController& GetController();
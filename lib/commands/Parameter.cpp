@@ -14,6 +14,18 @@ const char* ParameterName::powerSetW = "powerSetW";
 const char* ParameterName::maxTimeSetM = "maxTimeSetM";
 const char* ParameterName::unknown = "unknown";
 
+const char* ParameterName::Find(const String& name)
+{
+    const char* names[] = { currentA, voltageV, cutoffA, cutoffV, powerW, maxTimeM, capacityAh,
+                            currentSetA, voltageSetV, powerSetW, maxTimeSetM };
+    for (auto n : names) {
+        if (name == n) {
+            return n;
+        }
+    }
+    return unknown;
+}
+
 
 
 
@@ -38,14 +50,19 @@ bool ParameterStore::HasChanged(const char* parameterName)
                     return l.source != p.source;
                 }
             }
-            Logger::LogD(String(F("parameter ")) + String(parameterName) + F(" not found in last store"));
+            DLOGD("parameter %s not found in last store", parameterName);
             return true; // not found in last parameters -> so it has changed
         }
     }
-    Logger::LogD(String(F("parameter ")) + String(parameterName) + F(" not found in store"));
+    DLOGD("parameter %s not found in store", parameterName);
     return false; // not found in parameters -> not changed
 }
 
+const std::vector<Parameter>& ParameterStore::GetParameters() const
+{
+    return actualParameters;
+}
+
 double ParameterStore::GetValue(const char* parameterName)
 {
     for (auto & p : actualParameters) {
@@ -53,7 +70,7 @@ double ParameterStore::GetValue(const char* parameterName)
             return p.value;
         }
     }
-    Logger::LogD(String(F("parameter ")) + String(parameterName) + F(" not found in value store"));
+    DLOGD("parameter %s not found in value store", parameterName);
     return 0.0; // not found in parameters
 }
 
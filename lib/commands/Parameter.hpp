@@ -22,8 +22,21 @@ struct ParameterName
     static const char* powerSetW;
     static const char* maxTimeSetM;
     static const char* unknown;
+
+    static const char* Find(const String& name);    // the static name equal to name or unknown, for deferred logs
+};
+
+// static description of a parameter, used to decode responses without allocations
+struct ParameterDescriptor
+{
+    size_t              index;         // the position of this parameter in the 7 values
+    const char*         name;
+    const char*         key;           // precomputed json key: "name":
+    ParameterPacking    packing;
 };
 
+#define PARAMETER_DESCRIPTOR(index, name, packing) { index, #name, "\"" #name "\":", packing }
+
 struct Parameter
 {
     Parameter(size_t i, const char* n, ParameterPacking p, bool m = true)
@@ -43,8 +56,9 @@ class ParameterStore
         ParameterStore();
 
         void Push(const std::vector<Parameter>& parameters);
-        bool HasChanged(const char* parameterName);
+        bool HasChanged(const char* parameterName);     // parameterName: one of ParameterName, it is kept by the log
         double GetValue(const char* parameterName);
+        const std::vector<Parameter>& GetParameters() const;
 
     private:
 
@@ -82,6 +82,13 @@ const char* Command::GetCommandStr() const
 
 }
 
+CommandFrame Command::GetFrame() const
+{
+    CommandFrame frame;
+    memcpy(frame.bytes, buffer.data(), CommandFrame::LENGTH);
+    return frame;
+}
+
 void Command::FillBytes()
 {
     std::vector<uint8_t>& bytes = buffer;
@@ -99,13 +106,13 @@ void Command::FillBytes()
 void Command::SetParameter(const Parameter& parameter)
 {
     if (parameter.index < 0 || values.size() <= parameter.index) {
-        Logger::LogE(String(F("command parameter \"")) + parameter.name + F("\": index out of range"));
+        DLOGE("command parameter \"%s\": index out of range", ParameterName::Find(parameter.name));
         return; // skip this parameter, because it is not valid
     }
     uint16_t& value = this->values[parameter.index];
 
     if (! ((EbcController*)controller)->Encode(parameter.value, value, parameter.packing)) {
-        Logger::LogE(String(F("there is no encoder for parameter ")) + parameter.name + F(" in command message 0x") + String(command, HEX));
+        DLOGE("there is no encoder for parameter %s in command message 0x%02x", ParameterName::Find(parameter.name), (unsigned)command);
     }
 }
 
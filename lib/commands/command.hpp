@@ -3,6 +3,7 @@
 
 #include "Message.hpp"
 #include "Parameter.hpp"
+#include "CommandFrame.hpp"
 #include <vector>
 
 
@@ -22,6 +23,7 @@ class Command : public Message
 
         Command_t GetCommand() const;
         const char* GetCommandStr() const;
+        CommandFrame GetFrame() const;      // the encoded bytes, as they are sent
 
     protected:
 
@@ -1,5 +1,6 @@
 #include "Message.hpp"
 #include "Logger.hpp"
+#include "Profiler.hpp"
 
 Message::Message(size_t length)
 {
@@ -10,15 +11,17 @@ Message::Message(size_t length)
 
     failCounter = 0;
     crcCheckDisabled = false;
+    frames = 0;
+    crcFailures = 0;
+    shortReads = 0;
+    lastHash = 0;
+    repeated = false;
 }
 
 // fa 0a 0023 101c 0000 0000 0023 018c 0000 09 82 f8
 
 bool Message::CheckCRC()
 {
-    if (crcCheckDisabled)
-        return true;
-
     uint8_t cs = 0;
     for (size_t i = 1; i < (buffer.size()-2); i++) {
         cs = cs ^ buffer[i];
@@ -29,19 +32,35 @@ bool Message::CheckCRC()
         isValid = (((cs & 0xf0) == 0xf0) && ((cs & 0x0f) == buffer[buffer.size()-2]));
     }
     if (!isValid) {
-        Logger::LogE(String(F("crc check failed: 0x")) + String(cs, HEX) + F(" != 0x") + String(buffer[buffer.size()-2], HEX));
+        crcFailures++;
+    }
+    if (crcCheckDisabled)
+        return true;
+
+    if (!isValid) {
+        DLOGE("crc check failed: 0x%x != 0x%x", (unsigned)cs, (unsigned)buffer[buffer.size()-2]);
         failCounter++;
     } else {
         failCounter = 0;
     }
     if (5 < failCounter) {
         crcCheckDisabled = true;
-        Logger::LogE(F("crc check disabled!"));
+        LOGE(F("crc check disabled!"));
         return true;
     }
     return isValid;
 }
 
+// FNV-1a
+uint32_t Message::Hash() const
+{
+    uint32_t h = 2166136261UL;
+    for (const auto& b : buffer) {
+        h = (h ^ b) * 16777619UL;
+    }
+    return h;
+}
+
 void Message::CalcCRC()
 {
     FillBytes();
@@ -62,7 +81,7 @@ bool Message::Send(Stream& stream) const
     size_t num = stream.write(buffer.data(), buffer.size());
 
     if (num < buffer.size()) {
-        Logger::LogE("not enough data written");
+        LOGE("not enough data written");
         return false;
     }
     return true;
@@ -73,6 +92,7 @@ bool Message::Read(Stream& stream)
     if (stream.available() < 1) {
         return false;
     }
+    PROFILE_SCOPE(Prof_Read);
 
     // skip all bytes that are not 0xfa
     while (stream.peek() != startTag) {
@@ -81,27 +101,99 @@ bool Message::Read(Stream& stream)
 
     size_t num = stream.readBytes(buffer.data(), buffer.size());
     if (num < buffer.size()) {
-        Logger::LogE(F("not enough data read"));
+        DLOGE("not enough data read");
+        shortReads++;
         return false;
     }
 
+    // the charger repeats the same frame most of the time, this one is already checked and decoded
+    uint32_t hash = Hash();
+    repeated = (0 < frames) && (hash == lastHash);
+    if (repeated) {
+        frames++;
+        return true;
+    }
+
     if (CheckCRC()) {
         FillFromBytes();
+        frames++;
+        lastHash = hash;
         return true;
     }
 
-    Logger::LogE(String(F("crc check fails on read data: ")) + ToHexString());
+    DLOGE("crc check fails on read data");   // the frames are in raw/capture
     return false;
 }
 
 
+uint32_t Message::GetFrames() const
+{
+    return frames;
+}
+
+uint32_t Message::GetCrcFailures() const
+{
+    return crcFailures;
+}
+
+uint32_t Message::GetShortReads() const
+{
+    return shortReads;
+}
+
+bool Message::IsCrcCheckDisabled() const
+{
+    return crcCheckDisabled;
+}
+
+bool Message::IsRepeated() const
+{
+    return repeated;
+}
+
 String Message::ToHexString() const
 {
-    String s = "";
-    char str[4];
+    char str[2 * 32 + 1];
+    if (0 < WriteHex(str, sizeof(str))) {
+        return String(str);
+    }
+    String s;
+    s.reserve(2 * buffer.size());
     for (const auto& b : buffer) {
-        sprintf(str, "%02x", b);
-        s += str;
+        char hex[2];
+        AppendHex(hex, &b, 1);
+        s += hex[0];
+        s += hex[1];
     }
     return s;
 }
+
+size_t Message::WriteHex(char* buf, size_t len) const
+{
+    if (len < 2 * buffer.size() + 1) {
+        return 0;
+    }
+    char* p = AppendHex(buf, buffer.data(), buffer.size());
+    *p = '\0';
+    return p - buf;
+}
+
+char* Message::AppendHex(char* p, const uint8_t* data, size_t n)
+{
+    static const char digits[] = "0123456789abcdef";
+    for (size_t i = 0; i < n; ++i) {
+        *p++ = digits[data[i] >> 4];
+        *p++ = digits[data[i] & 0x0f];
+    }
+    return p;
+}
+
+const uint8_t* Message::GetData() const
+{
+    return buffer.data();
+}
+
+size_t Message::GetLength() const
+{
+    return buffer.size();
+}
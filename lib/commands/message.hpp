@@ -13,11 +13,27 @@ class Message
         bool Send(Stream& stream) const;
 
         String ToHexString() const;
+        size_t WriteHex(char* buf, size_t len) const;  // same as ToHexString(), 0 if buf is too small
+        static char* AppendHex(char* p, const uint8_t* data, size_t n);  // 2*n chars, not terminated
+
+        const uint8_t* GetData() const;
+        size_t         GetLength() const;
+
+        uint32_t GetFrames() const;         // valid frames read
+        uint32_t GetCrcFailures() const;    // all crc failures, also the ones accepted after disabling
+        uint32_t GetShortReads() const;     // frames cut off by the read timeout
+        bool     IsCrcCheckDisabled() const;
+        bool     IsRepeated() const;        // the last read frame equals the one before, it was not decoded again
 
     private:
 
-        int failCounter;
+        int failCounter;    // consecutive crc failures
         bool crcCheckDisabled;
+        uint32_t frames;
+        uint32_t crcFailures;
+        uint32_t shortReads;
+        uint32_t lastHash;  // of the last valid frame
+        bool     repeated;
 
     protected:
         std::vector<uint8_t> buffer;
@@ -30,6 +46,7 @@ class Message
         virtual void   FillBytes() {};
         void           CalcCRC();
         bool           CheckCRC();
+        uint32_t       Hash() const;
 };
 
 #endif // _MESSAGE_HPP_
\ No newline at end of file
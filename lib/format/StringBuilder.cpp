@@ -0,0 +1,161 @@
+#include "StringBuilder.hpp"
+
+
+
+StringBuilder::StringBuilder(char* b, size_t s)
+    : buf(b)
+    , size(s)
+    , length(0)
+    , truncated(false)
+{
+    if (0 < size) {
+        buf[0] = '\0';
+    }
+}
+
+void StringBuilder::Clear()
+{
+    length = 0;
+    truncated = false;
+    if (0 < size) {
+        buf[0] = '\0';
+    }
+}
+
+StringBuilder& StringBuilder::Add(char c)
+{
+    if (length + 1 < size) {
+        buf[length++] = c;
+        buf[length] = '\0';
+    } else {
+        truncated = true;
+    }
+    return *this;
+}
+
+StringBuilder& StringBuilder::Add(const char* s)
+{
+    if (s == nullptr) {
+        return *this;
+    }
+    while (*s != '\0') {
+        if (size <= length + 1) {
+            truncated = true;
+            break;
+        }
+        buf[length++] = *s++;
+    }
+    if (0 < size) {
+        buf[length] = '\0';
+    }
+    return *this;
+}
+
+StringBuilder& StringBuilder::Add(const __FlashStringHelper* s)
+{
+    PGM_P p = reinterpret_cast<PGM_P>(s);
+    char c;
+    while ((c = pgm_read_byte(p++)) != '\0') {
+        if (size <= length + 1) {
+            truncated = true;
+            break;
+        }
+        buf[length++] = c;
+    }
+    if (0 < size) {
+        buf[length] = '\0';
+    }
+    return *this;
+}
+
+StringBuilder& StringBuilder::Add(const String& s)
+{
+    return Add(s.c_str());
+}
+
+size_t StringBuilder::FormatUint(char* out, unsigned long v)
+{
+    char digits[12];
+    size_t n = 0;
+    do {
+        digits[n++] = '0' + (v % 10);
+        v /= 10;
+    } while (0 < v);
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = digits[n - 1 - i];
+    }
+    return n;
+}
+
+StringBuilder& StringBuilder::Add(unsigned long v)
+{
+    char s[12];
+    s[FormatUint(s, v)] = '\0';
+    return Add(s);
+}
+
+StringBuilder& StringBuilder::Add(long v)
+{
+    if (v < 0) {
+        Add('-');
+        return Add((unsigned long)(-(v + 1)) + 1);
+    }
+    return Add((unsigned long)v);
+}
+
+StringBuilder& StringBuilder::AddScaled(bool negative, unsigned long whole, unsigned long fraction, uint8_t decimals)
+{
+    if (negative) {
+        Add('-');
+    }
+    Add(whole);
+    if (0 < decimals) {
+        char s[12];
+        size_t n = FormatUint(s, fraction);
+        Add('.');
+        for (size_t i = n; i < decimals; ++i) {
+            Add('0');
+        }
+        s[n] = '\0';
+        Add(s);
+    }
+    return *this;
+}
+
+StringBuilder& StringBuilder::AddFixed(double v, uint8_t decimals)
+{
+    static const unsigned long scales[] = { 1, 10, 100, 1000, 10000, 100000, 1000000 };
+    if (6 < decimals) {
+        decimals = 6;
+    }
+    if (isnan(v)) {
+        return Add("nan");
+    }
+    if (4294967040.0 < fabs(v)) {
+        return Add("ovf");  // like String(double)
+    }
+    unsigned long scale = scales[decimals];
+    bool negative = (v < 0.0);
+    double a = negative ? -v : v;
+    unsigned long whole = (unsigned long)a;
+    unsigned long fraction = (unsigned long)((a - whole) * scale + 0.5);
+    if (scale <= fraction) {
+        whole++;
+        fraction -= scale;
+    }
+    return AddScaled(negative && ((0 < whole) || (0 < fraction)), whole, fraction, decimals);
+}
+
+StringBuilder& StringBuilder::AddMilli(int32_t milli, uint8_t decimals)
+{
+    static const uint32_t divisors[] = { 1000, 100, 10, 1 };
+    if (3 < decimals) {
+        decimals = 3;
+    }
+    bool negative = (milli < 0);
+    uint32_t a = negative ? (uint32_t)(-(int64_t)milli) : (uint32_t)milli;
+    uint32_t d = divisors[decimals];
+    a = (a + d / 2) / d;    // rounded to the decimals
+    uint32_t scale = 1000 / d;
+    return AddScaled(negative && (0 < a), a / scale, a % scale, decimals);
+}
@@ -0,0 +1,64 @@
+#ifndef _STRINGBUILDER_HPP_
+#define _STRINGBUILDER_HPP_
+
+#include <Arduino.h>
+
+
+// builds a string in a fixed buffer, usually on the stack, instead of String temporaries.
+// the text is always terminated, what does not fit is cut off and IsTruncated() is set.
+// numbers are formatted without printf: integers, fixed point values (like String(value, 3))
+// and values in 1/1000 of the unit.
+class StringBuilder
+{
+    public:
+
+        StringBuilder(char* buf, size_t size);
+
+        StringBuilder& Add(const char* s);
+        StringBuilder& Add(const __FlashStringHelper* s);
+        StringBuilder& Add(const String& s);
+        StringBuilder& Add(char c);
+        StringBuilder& Add(int v)           { return Add((long)v); }
+        StringBuilder& Add(unsigned int v)  { return Add((unsigned long)v); }
+        StringBuilder& Add(long v);
+        StringBuilder& Add(unsigned long v);
+        StringBuilder& AddFixed(double v, uint8_t decimals);
+        StringBuilder& AddMilli(int32_t milli, uint8_t decimals = 3);   // 4012 -> "4.012", decimals 0..3
+
+        template<class T>
+        StringBuilder& operator<<(const T& v) { return Add(v); }
+
+        const char* c_str() const           { return buf; }
+        size_t Length() const               { return length; }
+        bool IsTruncated() const            { return truncated; }
+        void Clear();
+
+        static size_t FormatUint(char* out, unsigned long v);  // at least 11 chars, not terminated
+
+    private:
+
+        StringBuilder& AddScaled(bool negative, unsigned long whole, unsigned long fraction, uint8_t decimals);
+
+        char*  buf;
+        size_t size;
+        size_t length;
+        bool   truncated;
+};
+
+// a StringBuilder with its own buffer
+template<size_t N>
+class StackString : public StringBuilder
+{
+    public:
+
+        StackString() : StringBuilder(data, N) {}
+
+        StackString(const StackString&) = delete;
+        void operator=(const StackString&) = delete;
+
+    private:
+
+        char data[N];
+};
+
+#endif // _STRINGBUILDER_HPP_
@@ -0,0 +1,106 @@
+#include "FastStop.hpp"
+
+
+FastStop::FastStop()
+    : armed(false), armedAt(0), sentInFrame(0), sent(false),
+      lastLatency(0), maxLatency(0), stops(0), sends(0), failures(0)
+{
+}
+
+void FastStop::Arm(unsigned long now)
+{
+    if (armed) {
+        return; // keep the first request, the latency counts from there
+    }
+    armed = true;
+    armedAt = now;
+    sent = false;
+}
+
+bool FastStop::IsArmed() const
+{
+    return armed;
+}
+
+bool FastStop::ShouldSend(unsigned long now, const FrameClock& clock) const
+{
+    if (!armed) {
+        return false;
+    }
+    if (!clock.HasFrame()) {
+        return !sent; // no cadence known, send once blind
+    }
+    if (sent && sentInFrame == clock.GetLastFrame()) {
+        return false; // only one stop frame per gap
+    }
+    return clock.IsTxWindowOpen(now);
+}
+
+void FastStop::OnSent(const FrameClock& clock)
+{
+    sent = true;
+    sentInFrame = clock.GetLastFrame();
+    sends++;
+}
+
+void FastStop::OnStopped(unsigned long now)
+{
+    if (!armed) {
+        return;
+    }
+    armed = false;
+    lastLatency = now - armedAt;
+    if (maxLatency < lastLatency) {
+        maxLatency = lastLatency;
+    }
+    stops++;
+}
+
+bool FastStop::IsExpired(unsigned long now, const FrameClock& clock) const
+{
+    return armed && (GIVE_UP_PERIODS * clock.GetPeriod() <= now - armedAt);
+}
+
+void FastStop::GiveUp(unsigned long now)
+{
+    if (!armed) {
+        return;
+    }
+    armed = false;
+    lastLatency = now - armedAt;
+    failures++;
+}
+
+unsigned long FastStop::GetLastLatency() const
+{
+    return lastLatency;
+}
+
+unsigned long FastStop::GetMaxLatency() const
+{
+    return maxLatency;
+}
+
+uint32_t FastStop::GetStops() const
+{
+    return stops;
+}
+
+uint32_t FastStop::GetSends() const
+{
+    return sends;
+}
+
+uint32_t FastStop::GetFailures() const
+{
+    return failures;
+}
+
+void FastStop::WriteStatsJson(StringBuilder& json) const
+{
+    json << F("{\"stops\":") << stops
+        << F(",\"failed\":") << failures
+        << F(",\"sends\":") << sends
+        << F(",\"lastMs\":") << lastLatency
+        << F(",\"maxMs\":") << maxLatency << '}';
+}
@@ -0,0 +1,51 @@
+#ifndef _FASTSTOP_HPP_
+#define _FASTSTOP_HPP_
+
+#include <Arduino.h>
+#include "FrameClock.hpp"
+#include "StringBuilder.hpp"
+
+
+// low latency stop path beside the fsm and the command queue.
+// once armed, a stop frame is written in every safe gap until the charger
+// reports a stopped (or finished) mode. it gives up after GIVE_UP_PERIODS
+// frame periods, so a charger that never confirms does not block the link.
+class FastStop
+{
+    public:
+
+        static const unsigned long GIVE_UP_PERIODS = 20;
+
+        FastStop();
+
+        void Arm(unsigned long now);
+        bool IsArmed() const;
+
+        bool ShouldSend(unsigned long now, const FrameClock& clock) const;
+        void OnSent(const FrameClock& clock);
+        void OnStopped(unsigned long now);
+        bool IsExpired(unsigned long now, const FrameClock& clock) const;
+        void GiveUp(unsigned long now);         // disarms without a confirmed stop
+
+        unsigned long GetLastLatency() const;   // arm -> stopped mode observed (ms)
+        unsigned long GetMaxLatency() const;
+        uint32_t GetStops() const;
+        uint32_t GetSends() const;              // stop frames written (including re-assertions)
+        uint32_t GetFailures() const;           // stops given up
+        void WriteStatsJson(StringBuilder& json) const;
+
+    private:
+
+        bool          armed;
+        unsigned long armedAt;
+        unsigned long sentInFrame;  // end of the frame whose gap was used for the last send
+        bool          sent;
+
+        unsigned long lastLatency;
+        unsigned long maxLatency;
+        uint32_t      stops;
+        uint32_t      sends;
+        uint32_t      failures;
+};
+
+#endif // _FASTSTOP_HPP_
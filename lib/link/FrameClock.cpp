@@ -0,0 +1,74 @@
+#include "FrameClock.hpp"
+
+
+FrameClock::FrameClock()
+{
+    Reset();
+}
+
+void FrameClock::Reset()
+{
+    lastFrame = 0;
+    period = DEFAULT_PERIOD_MS;
+    samples = 0;
+    hasFrame = false;
+}
+
+void FrameClock::OnFrame(unsigned long now)
+{
+    if (hasFrame) {
+        unsigned long interval = now - lastFrame;
+        if (MIN_PERIOD_MS <= interval && interval <= MAX_PERIOD_MS) {
+            if (samples == 0) {
+                period = interval;
+            } else {
+                // exponential moving average (1/4), robust against a single late frame
+                period = (3 * period + interval) / 4;
+            }
+            if (samples < 0xffff) {
+                samples++;
+            }
+        }
+    }
+    lastFrame = now;
+    hasFrame = true;
+}
+
+bool FrameClock::HasFrame() const
+{
+    return hasFrame;
+}
+
+bool FrameClock::HasPeriod() const
+{
+    return 0 < samples;
+}
+
+unsigned long FrameClock::GetPeriod() const
+{
+    return period;
+}
+
+unsigned long FrameClock::GetLastFrame() const
+{
+    return lastFrame;
+}
+
+bool FrameClock::IsTxWindowOpen(unsigned long now) const
+{
+    if (!hasFrame) {
+        return false;
+    }
+    // leave enough room for our 10 byte frame before the charger starts to talk again
+    return (now - lastFrame) < (period / 2);
+}
+
+unsigned long FrameClock::GetAckTimeout() const
+{
+    if (!HasPeriod()) {
+        return 3000;
+    }
+    // the acknowledge is expected in the next frame, allow one frame to be lost
+    unsigned long timeout = 2 * period + FRAME_TIME_MS;
+    return (timeout < MIN_ACK_TIMEOUT_MS) ? MIN_ACK_TIMEOUT_MS : timeout;
+}
@@ -0,0 +1,41 @@
+#ifndef _FRAMECLOCK_HPP_
+#define _FRAMECLOCK_HPP_
+
+#include <Arduino.h>
+
+
+// measures the cadence of the frames sent by the charger.
+// the charger is not full duplex, so we may only send while it is silent. the
+// safe gap starts at the end of a received frame and lasts about half a period.
+class FrameClock
+{
+    public:
+
+        static const unsigned long DEFAULT_PERIOD_MS = 1000; // until the first period is measured
+        static const unsigned long MIN_PERIOD_MS     = 50;   // shorter intervals are bursts, not periods
+        static const unsigned long MAX_PERIOD_MS     = 5000; // longer intervals are gaps, not periods
+        static const unsigned long FRAME_TIME_MS     = 25;   // 19 bytes at 9600 baud 8O1
+        static const unsigned long MIN_ACK_TIMEOUT_MS = 300;
+
+        FrameClock();
+
+        void Reset();
+        void OnFrame(unsigned long now);    // call at the end of every received frame
+
+        bool HasFrame() const;
+        bool HasPeriod() const;
+        unsigned long GetPeriod() const;
+        unsigned long GetLastFrame() const;
+
+        bool IsTxWindowOpen(unsigned long now) const;
+        unsigned long GetAckTimeout() const;
+
+    private:
+
+        unsigned long lastFrame;
+        unsigned long period;       // smoothed frame period (ms)
+        uint16_t      samples;
+        bool          hasFrame;
+};
+
+#endif // _FRAMECLOCK_HPP_
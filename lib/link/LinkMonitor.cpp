@@ -0,0 +1,114 @@
+#include "LinkMonitor.hpp"
+
+
+LinkMonitor::LinkMonitor()
+    : state(Link_Idle), expected(false), expectedSince(0), lostSince(0),
+      lost(0), lateFrames(0), lastGap(0), maxGap(0)
+{
+}
+
+bool LinkMonitor::SetExpected(bool e, unsigned long now)
+{
+    if (e == expected) {
+        return false;
+    }
+    expected = e;
+    expectedSince = now;
+    state = expected ? Link_Up : Link_Idle;
+    return true;
+}
+
+unsigned long LinkMonitor::GetTimeout(const FrameClock& clock) const
+{
+    return 2 * clock.GetPeriod() + FrameClock::FRAME_TIME_MS;
+}
+
+bool LinkMonitor::Check(unsigned long now, const FrameClock& clock)
+{
+    if (!expected || state == Link_Lost) {
+        return false;
+    }
+    // the last frame may be older than the connection (e.g. after a reconnect)
+    unsigned long last = clock.GetLastFrame();
+    if (!clock.HasFrame() || (long)(last - expectedSince) < 0) {
+        last = expectedSince;
+    }
+    if (GetTimeout(clock) <= (now - last)) {
+        state = Link_Lost;
+        lostSince = last;
+        lost++;
+        return true;
+    }
+    state = Link_Up;
+    return false;
+}
+
+bool LinkMonitor::OnFrame(unsigned long now, const FrameClock& clock)
+{
+    if (clock.HasFrame()) {
+        unsigned long interval = now - clock.GetLastFrame();
+        if (maxGap < interval) {
+            maxGap = interval;
+        }
+        if (clock.HasPeriod() && (3 * clock.GetPeriod() / 2) < interval) {
+            lateFrames++;
+        }
+    }
+    if (state == Link_Lost) {
+        state = expected ? Link_Up : Link_Idle;
+        lastGap = now - lostSince;
+        return true;
+    }
+    if (expected) {
+        state = Link_Up;
+    }
+    return false;
+}
+
+LinkMonitor::LinkState LinkMonitor::GetState() const
+{
+    return state;
+}
+
+const char* LinkMonitor::StateAsString() const
+{
+    switch (state)
+    {
+    case Link_Up:   return "up";
+    case Link_Lost: return "lost";
+    default:        return "idle";
+    }
+}
+
+unsigned long LinkMonitor::GetLostSince() const
+{
+    return lostSince;
+}
+
+uint32_t LinkMonitor::GetLost() const
+{
+    return lost;
+}
+
+uint32_t LinkMonitor::GetLateFrames() const
+{
+    return lateFrames;
+}
+
+unsigned long LinkMonitor::GetLastGap() const
+{
+    return lastGap;
+}
+
+unsigned long LinkMonitor::GetMaxGap() const
+{
+    return maxGap;
+}
+
+void LinkMonitor::WriteStatsJson(StringBuilder& json) const
+{
+    json << F("{\"lost\":") << lost
+        << F(",\"late\":") << lateFrames
+        << F(",\"lastGapMs\":") << lastGap
+        << F(",\"maxGapMs\":") << maxGap << '}';
+}
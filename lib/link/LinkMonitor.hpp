@@ -0,0 +1,50 @@
+#ifndef _LINKMONITOR_HPP_
+#define _LINKMONITOR_HPP_
+
+#include <Arduino.h>
+#include "FrameClock.hpp"
+#include "StringBuilder.hpp"
+
+
+// watches the frame cadence of a connected charger.
+// a missed-frame condition is raised if no frame arrived within about two frame
+// periods, the link is back (resynced) with the next received frame.
+class LinkMonitor
+{
+    public:
+
+        enum LinkState { Link_Idle, Link_Up, Link_Lost };
+
+        LinkMonitor();
+
+        bool SetExpected(bool expected, unsigned long now);   // frames are expected (connected), true on change
+
+        bool Check(unsigned long now, const FrameClock& clock);   // true if the link got lost
+        bool OnFrame(unsigned long now, const FrameClock& clock); // true if the link is resynced, call before clock.OnFrame()
+
+        LinkState GetState() const;
+        const char* StateAsString() const;
+        unsigned long GetLostSince() const;
+
+        unsigned long GetTimeout(const FrameClock& clock) const;
+
+        uint32_t GetLost() const;           // number of missed-frame conditions
+        uint32_t GetLateFrames() const;     // frames later than 1.5 periods
+        unsigned long GetLastGap() const;   // duration of the last lost period (ms)
+        unsigned long GetMaxGap() const;    // longest interval between two frames (ms)
+        void WriteStatsJson(StringBuilder& json) const;
+
+    private:
+
+        LinkState     state;
+        bool          expected;
+        unsigned long expectedSince;
+        unsigned long lostSince;
+
+        uint32_t      lost;
+        uint32_t      lateFrames;
+        unsigned long lastGap;
+        unsigned long maxGap;
+};
+
+#endif // _LINKMONITOR_HPP_
@@ -0,0 +1,183 @@
+#include "LogRing.hpp"
+#include "StringBuilder.hpp"
+
+
+LogRing::LogRing()
+    : head(0)
+    , count(0)
+    , dropped(0)
+{
+    for (auto& e : emitted) {
+        e.fmt = nullptr;
+        e.time = 0;
+    }
+}
+
+void LogRing::Add(uint8_t severity, PGM_P fmt, const LogArg& a, const LogArg& b, const LogArg& c)
+{
+    for (size_t i = 0; i < count; ++i) {
+        Entry& e = entries[(head + i) % MAX_ENTRIES];
+        if ((e.fmt == fmt) && (e.severity == severity)) {
+            e.args[0] = a;
+            e.args[1] = b;
+            e.args[2] = c;
+            if (e.repeats < 0xffff) {
+                e.repeats++;
+            }
+            return;
+        }
+    }
+    if (count == MAX_ENTRIES) {
+        head = (head + 1) % MAX_ENTRIES;
+        count--;
+        dropped++;
+    }
+    Entry& e = entries[(head + count) % MAX_ENTRIES];
+    e.fmt = fmt;
+    e.args[0] = a;
+    e.args[1] = b;
+    e.args[2] = c;
+    e.repeats = 0;
+    e.severity = severity;
+    count++;
+}
+
+size_t LogRing::GetCount() const
+{
+    return count;
+}
+
+uint32_t LogRing::GetDropped() const
+{
+    return dropped;
+}
+
+size_t LogRing::Format(const Entry& e, char* buf, size_t len) const
+{
+    size_t n = 0;
+    size_t arg = 0;
+    PGM_P p = e.fmt;
+    char c;
+    while (((c = pgm_read_byte(p++)) != '\0') && (n + 1 < len)) {
+        if (c != '%') {
+            buf[n++] = c;
+            continue;
+        }
+        c = pgm_read_byte(p++);
+        if (c == '%') {
+            buf[n++] = c;
+            continue;
+        }
+        bool zero = (c == '0');
+        int width = 0;
+        while (('0' <= c) && (c <= '9')) {
+            width = width * 10 + (c - '0');
+            c = pgm_read_byte(p++);
+        }
+        int precision = 6;
+        if (c == '.') {
+            precision = 0;
+            c = pgm_read_byte(p++);
+            while (('0' <= c) && (c <= '9')) {
+                precision = precision * 10 + (c - '0');
+                c = pgm_read_byte(p++);
+            }
+        }
+        while (c == 'l') {
+            c = pgm_read_byte(p++);
+        }
+        if (c == '\0') {
+            break;
+        }
+        const LogArg& a = (arg < MAX_ARGS) ? e.args[arg++] : LogArg();
+        char number[24];
+        const char* text = number;
+        if ((c == 's') && (a.kind == LogArg::Arg_String)) {
+            text = (a.value.s != nullptr) ? a.value.s : "(null)";
+        } else
+        if ((c == 'f') && (a.kind == LogArg::Arg_Float)) {
+            StringBuilder b(number, sizeof(number));
+            b.AddFixed(a.value.f, precision);
+        } else
+        if (c == 'x') {
+            snprintf(number, sizeof(number), zero ? "%0*lx" : "%*lx", width, a.value.u);
+        } else
+        if ((c == 'u') || (a.kind == LogArg::Arg_Uint)) {
+            snprintf(number, sizeof(number), zero ? "%0*lu" : "%*lu", width, a.value.u);
+        } else
+        if (a.kind == LogArg::Arg_Int) {
+            snprintf(number, sizeof(number), zero ? "%0*ld" : "%*ld", width, a.value.i);
+        } else {
+            text = "?";
+        }
+        while ((*text != '\0') && (n + 1 < len)) {
+            buf[n++] = *text++;
+        }
+    }
+    if (0 < e.repeats) {
+        int m = snprintf(buf + n, len - n, " (%u times)", e.repeats + 1);
+        n = ((m < 0) || (len - n <= (size_t)m)) ? len - 1 : n + m;
+    }
+    buf[n] = '\0';
+    return n;
+}
+
+bool LogRing::IsLimited(PGM_P fmt, unsigned long now) const
+{
+    for (const auto& e : emitted) {
+        if (e.fmt == fmt) {
+            return now - e.time < RATE_LIMIT_MS;
+        }
+    }
+    return false;
+}
+
+void LogRing::SetEmitted(PGM_P fmt, unsigned long now)
+{
+    Emitted* oldest = &emitted[0];
+    for (auto& e : emitted) {
+        if ((e.fmt == fmt) || (e.fmt == nullptr)) {
+            oldest = &e;
+            break;
+        }
+        if (now - oldest->time < now - e.time) {
+            oldest = &e;
+        }
+    }
+    oldest->fmt = fmt;
+    oldest->time = now;
+}
+
+void LogRing::Flush(Sink sink, unsigned long now)
+{
+    char batch[MAX_BATCH_LEN];
+    size_t len = 0;
+    uint8_t severity = 0;
+    for (size_t pending = count; 0 < pending; --pending) {
+        Entry e = entries[head];
+        head = (head + 1) % MAX_ENTRIES;
+        count--;
+        if (IsLimited(e.fmt, now)) {
+            // stays pending until the rate limit has elapsed
+            entries[(head + count) % MAX_ENTRIES] = e;
+            count++;
+            continue;
+        }
+        SetEmitted(e.fmt, now);
+        char line[MAX_BATCH_LEN];
+        size_t n = Format(e, line, sizeof(line));
+        if ((0 < len) && ((e.severity != severity) || (MAX_BATCH_LEN <= len + 1 + n))) {
+            sink(severity, batch);
+            len = 0;
+        }
+        if (0 < len) {
+            batch[len++] = '\n';
+        }
+        memcpy(batch + len, line, n + 1);
+        len += n;
+        severity = e.severity;
+    }
+    if (0 < len) {
+        sink(severity, batch);
+    }
+}
@@ -0,0 +1,84 @@
+#ifndef _LOGRING_HPP_
+#define _LOGRING_HPP_
+
+#include <Arduino.h>
+
+
+// an argument of a deferred log message: an integer, a floating point value (kept as float)
+// or a string with static storage in ram
+struct LogArg
+{
+    enum Kind : uint8_t { Arg_None, Arg_Int, Arg_Uint, Arg_Float, Arg_String };
+
+    LogArg()                    : kind(Arg_None)   { value.i = 0; }
+    LogArg(int v)               : kind(Arg_Int)    { value.i = v; }
+    LogArg(long v)              : kind(Arg_Int)    { value.i = v; }
+    LogArg(unsigned int v)      : kind(Arg_Uint)   { value.u = v; }
+    LogArg(unsigned long v)     : kind(Arg_Uint)   { value.u = v; }
+    LogArg(double v)            : kind(Arg_Float)  { value.f = v; }
+    LogArg(const char* v)       : kind(Arg_String) { value.s = v; }
+
+    Kind kind;
+    union {
+        long          i;
+        unsigned long u;
+        float         f;
+        const char*   s;
+    } value;
+};
+
+// records log messages as the pointer to their format string plus the binary arguments.
+// the text is formatted later, when the ring is flushed. a message with the format of a
+// pending one is not recorded again, the pending one takes the latest arguments and counts
+// the repeat. a format is flushed at most once per RATE_LIMIT_MS, until then it stays
+// pending and keeps counting. if the ring is full the oldest message is dropped.
+// the format knows %d, %u, %x with an optional width (%02x), %f with an optional
+// precision (%.3f), %s and %%.
+class LogRing
+{
+    public:
+
+        static const size_t MAX_ENTRIES = 16;
+        static const size_t MAX_ARGS = 3;
+        static const size_t MAX_BATCH_LEN = 256;
+        static const unsigned long RATE_LIMIT_MS = 10000;
+
+        typedef void (*Sink) (uint8_t severity, const char* text);
+
+        LogRing();
+
+        void Add(uint8_t severity, PGM_P fmt, const LogArg& a, const LogArg& b, const LogArg& c);
+        size_t GetCount() const;
+        uint32_t GetDropped() const;
+
+        // the messages of the same severity are joined by '\n', one call of sink per batch
+        void Flush(Sink sink, unsigned long now);
+
+    private:
+
+        struct Entry
+        {
+            PGM_P    fmt;
+            LogArg   args[MAX_ARGS];
+            uint16_t repeats;
+            uint8_t  severity;
+        };
+
+        struct Emitted
+        {
+            PGM_P         fmt;
+            unsigned long time;
+        };
+
+        size_t Format(const Entry& e, char* buf, size_t len) const;
+        bool IsLimited(PGM_P fmt, unsigned long now) const;
+        void SetEmitted(PGM_P fmt, unsigned long now);
+
+        Entry    entries[MAX_ENTRIES];
+        Emitted  emitted[MAX_ENTRIES];  // the formats flushed lately
+        size_t   head;      // the oldest message
+        size_t   count;
+        uint32_t dropped;
+};
+
+#endif // _LOGRING_HPP_
@@ -5,6 +5,9 @@
 
 Logger::Logger()
     : log(nullptr)
+    , debug(false)
+    , level(Debug)
+    , reportedDrops(0)
 {
 }
 
@@ -14,6 +17,27 @@ void Logger::SetLogger(LogDelegate l)
     log = l;
 }
 
+void Logger::SetDebug(bool enabled)
+{
+    debug = enabled;
+}
+
+void Logger::SetLevel(LogSeverity l)
+{
+    level = l;
+}
+
+bool Logger::IsDebugEnabled()
+{
+    return IsEnabled(Debug);
+}
+
+bool Logger::IsEnabled(LogSeverity l)
+{
+    const Logger& logger = GetInstance();
+    return (EBC_LOG_LEVEL <= l) && (logger.level <= l) && ((l != Debug) || logger.debug);
+}
+
 void Logger::Log(LogSeverity l, const String& msg) const
 {
     Log(l, msg.c_str());
@@ -21,6 +45,9 @@ void Logger::Log(LogSeverity l, const String& msg) const
 
 void Logger::Log(LogSeverity l, const char* msg) const
 {
+    if (!IsEnabled(l)) {
+        return;
+    }
     if (log != nullptr)
     {
         log(l, msg);
@@ -56,3 +83,32 @@ void Logger::LogD(const String& msg)
 {
     GetInstance().Log(Debug, msg);
 }
+
+void Logger::Defer(LogSeverity l, PGM_P fmt, const LogArg& a, const LogArg& b, const LogArg& c)
+{
+    if (!IsEnabled(l)) {
+        return;
+    }
+    GetInstance().ring.Add(l, fmt, a, b, c);
+}
+
+void Logger::Flush()
+{
+    if (log == nullptr) {
+        return;
+    }
+    if (reportedDrops != ring.GetDropped()) {
+        char msg[48];
+        snprintf(msg, sizeof(msg), "%lu log messages dropped", (unsigned long)(ring.GetDropped() - reportedDrops));
+        reportedDrops = ring.GetDropped();
+        Log(Error, msg);
+    }
+    ring.Flush([] (uint8_t severity, const char* text) {
+        GetInstance().Log((LogSeverity)severity, text);
+    }, millis());
+}
+
+size_t Logger::GetPending() const
+{
+    return ring.GetCount();
+}
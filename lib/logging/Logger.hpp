@@ -2,12 +2,57 @@
 #define _LOGGER_HPP_
 
 #include <Arduino.h>
+#include "LogRing.hpp"
+
+// the lowest severity that is compiled in: 0 = debug, 1 = message, 2 = error, 3 = none.
+// the calls of lower severities are removed with their arguments, set it per environment
+// in platformio.ini (-D EBC_LOG_LEVEL=1).
+#ifndef EBC_LOG_LEVEL
+#define EBC_LOG_LEVEL 0
+#endif
+
+// the message is only formatted if its severity is enabled at runtime
+#define LOG_IF(l, call) do { if (Logger::IsEnabled(l)) { call; } } while (0)
+
+#if EBC_LOG_LEVEL <= 0
+#define LOGD(msg)       LOG_IF(Logger::Debug, Logger::LogD(msg))
+#else
+#define LOGD(msg)       do { } while (0)
+#endif
+#if EBC_LOG_LEVEL <= 1
+#define LOGM(msg)       LOG_IF(Logger::Message, Logger::LogM(msg))
+#else
+#define LOGM(msg)       do { } while (0)
+#endif
+#if EBC_LOG_LEVEL <= 2
+#define LOGE(msg)       LOG_IF(Logger::Error, Logger::LogE(msg))
+#else
+#define LOGE(msg)       do { } while (0)
+#endif
+
+// deferred logging for the hot path: the format string stays in flash and is formatted
+// with up to three integer, floating point or static string arguments when the ring is flushed
+#if EBC_LOG_LEVEL <= 0
+#define DLOGD(fmt, ...) LOG_IF(Logger::Debug, Logger::Defer(Logger::Debug, PSTR(fmt), ##__VA_ARGS__))
+#else
+#define DLOGD(fmt, ...) do { } while (0)
+#endif
+#if EBC_LOG_LEVEL <= 1
+#define DLOGM(fmt, ...) LOG_IF(Logger::Message, Logger::Defer(Logger::Message, PSTR(fmt), ##__VA_ARGS__))
+#else
+#define DLOGM(fmt, ...) do { } while (0)
+#endif
+#if EBC_LOG_LEVEL <= 2
+#define DLOGE(fmt, ...) LOG_IF(Logger::Error, Logger::Defer(Logger::Error, PSTR(fmt), ##__VA_ARGS__))
+#else
+#define DLOGE(fmt, ...) do { } while (0)
+#endif
 
 class Logger
 {
     public:
 
-        enum LogSeverity {Debug, Message, Error};
+        enum LogSeverity {Debug, Message, Error, None};
         typedef void (*LogDelegate) (LogSeverity level, const char* msg);
 
         static Logger& GetInstance()
@@ -20,6 +65,10 @@ class Logger
         void operator=(Logger const&) = delete;
 
         void SetLogger(LogDelegate l);
+        void SetDebug(bool enabled);            // the debug messages are off by default
+        void SetLevel(LogSeverity l);           // the runtime threshold
+        static bool IsDebugEnabled();
+        static bool IsEnabled(LogSeverity l);
         void Log(LogSeverity l, const String& msg) const;
         void Log(LogSeverity l, const char* msg) const;
 
@@ -30,11 +79,19 @@ class Logger
         static void LogM(const String& msg); // log info messages
         static void LogD(const String& msg); // log debug messages
 
+        static void Defer(LogSeverity l, PGM_P fmt, const LogArg& a = LogArg(), const LogArg& b = LogArg(), const LogArg& c = LogArg());
+        void Flush();   // formats and logs the deferred messages
+        size_t GetPending() const;
+
     private:
 
         Logger();
 
         LogDelegate log;
+        bool        debug;
+        LogSeverity level;
+        LogRing     ring;
+        uint32_t    reportedDrops;
 };
 
 #endif // _LOGGER_HPP_
\ No newline at end of file
@@ -0,0 +1,109 @@
+#include "FrameArena.hpp"
+
+
+
+FrameArena::FrameArena()
+    : used(0)
+    , last(0)
+    , live(0)
+    , highWater(0)
+    , fallbacks(0)
+    , leaks(0)
+{
+}
+
+bool FrameArena::Owns(const void* p) const
+{
+    return (buffer <= (const uint8_t*)p) && ((const uint8_t*)p < buffer + SIZE);
+}
+
+void* FrameArena::Allocate(size_t n)
+{
+    if (n == 0) {
+        return nullptr;
+    }
+    size_t start = (used + ALIGN - 1) & ~(ALIGN - 1);
+    if ((SIZE < start) || (SIZE - start < n)) {
+        fallbacks++;
+        return malloc(n);
+    }
+    last = start;
+    used = start + n;
+    live++;
+    if (highWater < used) {
+        highWater = used;
+    }
+    return buffer + start;
+}
+
+void FrameArena::Free(void* p)
+{
+    if (p == nullptr) {
+        return;
+    }
+    if (!Owns(p)) {
+        free(p);
+        return;
+    }
+    if (0 < live) {
+        live--;
+    }
+    if ((live == 0) || (buffer + last == p)) {
+        // the last block is given back at once, so a document can be allocated again
+        used = (live == 0) ? 0 : last;
+    }
+}
+
+void* FrameArena::Reallocate(void* p, size_t n)
+{
+    if (p == nullptr) {
+        return Allocate(n);
+    }
+    if (!Owns(p)) {
+        return realloc(p, n);
+    }
+    if ((buffer + last == p) && (n <= SIZE - last)) {
+        used = last + n;
+        if (highWater < used) {
+            highWater = used;
+        }
+        return p;
+    }
+    size_t old = used - ((uint8_t*)p - buffer);     // at most the rest of the used area
+    void* q = Allocate(n);
+    if (q != nullptr) {
+        memcpy(q, p, (old < n) ? old : n);
+        Free(p);
+    }
+    return q;
+}
+
+void FrameArena::Reset()
+{
+    if (0 < live) {
+        leaks += live;
+    }
+    used = 0;
+    last = 0;
+    live = 0;
+}
+
+size_t FrameArena::GetUsed() const
+{
+    return used;
+}
+
+size_t FrameArena::GetHighWater() const
+{
+    return highWater;
+}
+
+uint32_t FrameArena::GetFallbacks() const
+{
+    return fallbacks;
+}
+
+uint32_t FrameArena::GetLeaks() const
+{
+    return leaks;
+}
@@ -0,0 +1,73 @@
+#ifndef _FRAMEARENA_HPP_
+#define _FRAMEARENA_HPP_
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// the worst case of an iteration is the binary copy of a json property: the document
+// (2 * json + 128) and the MessagePack output. 4k hold it for a program of 1k. on the
+// ESP8266 2k are enough for the responses, a large program or result falls back to malloc()
+#ifndef FRAME_ARENA_SIZE
+#ifdef ESP32
+#define FRAME_ARENA_SIZE 4096
+#else
+#define FRAME_ARENA_SIZE 2048
+#endif
+#endif
+
+
+// a bump allocator for the transient work of one loop iteration (json documents, string
+// buffers). the memory is freed all at once by Reset() at the end of the iteration, so it
+// never fragments the heap. nothing allocated here may be kept beyond the iteration.
+// a request that does not fit is served by malloc() and counted as fallback.
+class FrameArena
+{
+    public:
+
+        static const size_t SIZE = FRAME_ARENA_SIZE;
+        static const size_t ALIGN = 8;
+
+        static FrameArena& GetInstance()
+        {
+            static FrameArena instance;
+            return instance;
+        }
+
+        FrameArena(FrameArena const&) = delete;
+        void operator=(FrameArena const&) = delete;
+
+        void* Allocate(size_t n);
+        void  Free(void* p);                    // arena memory is only freed by Reset()
+        void* Reallocate(void* p, size_t n);    // in place for the last block
+        void  Reset();                          // end of the loop iteration
+
+        bool     Owns(const void* p) const;
+        size_t   GetUsed() const;
+        size_t   GetHighWater() const;          // max bytes used in one iteration
+        uint32_t GetFallbacks() const;          // requests served by malloc()
+        uint32_t GetLeaks() const;              // blocks still in use at Reset()
+
+    private:
+
+        FrameArena();
+
+        alignas(ALIGN) uint8_t buffer[SIZE];
+        size_t   used;
+        size_t   last;          // offset of the last block
+        size_t   live;          // arena blocks not freed yet
+        size_t   highWater;
+        uint32_t fallbacks;
+        uint32_t leaks;
+};
+
+// allocator of ArduinoJson for documents that live within one loop iteration
+struct FrameArenaAllocator
+{
+    void* allocate(size_t n)                { return FrameArena::GetInstance().Allocate(n); }
+    void  deallocate(void* p)               { FrameArena::GetInstance().Free(p); }
+    void* reallocate(void* p, size_t n)     { return FrameArena::GetInstance().Reallocate(p, n); }
+};
+
+typedef BasicJsonDocument<FrameArenaAllocator> FrameJsonDocument;
+
+#endif // _FRAMEARENA_HPP_
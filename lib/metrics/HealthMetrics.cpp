@@ -0,0 +1,65 @@
+#include "HealthMetrics.hpp"
+#include "FrameArena.hpp"
+
+
+
+HealthMetrics::HealthMetrics(const Message& m, const TimerWheel& t)
+    : input(m)
+    , timers(t)
+    , loops(0)
+    , loopsSince(0)
+    , publishFailures(0)
+    , publishSuppressed(0)
+    , skippedFrames(0)
+    , eventHighWater(0)
+{
+}
+
+uint32_t HealthMetrics::GetPublishFailures() const
+{
+    return publishFailures;
+}
+
+size_t HealthMetrics::GetEventHighWater() const
+{
+    return eventHighWater;
+}
+
+uint32_t HealthMetrics::GetLoopRate(unsigned long now)
+{
+    unsigned long elapsed = now - loopsSince;
+    uint32_t rate = (0 < elapsed) ? (uint32_t)(((uint64_t)loops * 1000) / elapsed) : 0;
+    loops = 0;
+    loopsSince = now;
+    return rate;
+}
+
+void HealthMetrics::WriteStatsJson(StringBuilder& json, unsigned long now)
+{
+    uint32_t freeHeap = ESP.getFreeHeap();
+#ifdef ESP8266
+    uint32_t maxBlock = ESP.getMaxFreeBlockSize();
+#else
+    uint32_t maxBlock = ESP.getMaxAllocHeap();
+#endif
+    uint32_t fragmentation = (0 < freeHeap) ? (100 - ((uint64_t)maxBlock * 100) / freeHeap) : 0;
+    const FrameArena& arena = FrameArena::GetInstance();
+
+    json << F("{\"frames\":") << input.GetFrames()
+        << F(",\"crcFailures\":") << input.GetCrcFailures()
+        << F(",\"crcDisabled\":") << (input.IsCrcCheckDisabled() ? F("true") : F("false"))
+        << F(",\"shortReads\":") << input.GetShortReads()
+        << F(",\"skippedFrames\":") << skippedFrames
+        << F(",\"publishFailures\":") << publishFailures
+        << F(",\"publishSuppressed\":") << publishSuppressed
+        << F(",\"freeHeap\":") << freeHeap
+        << F(",\"maxFreeBlock\":") << maxBlock
+        << F(",\"fragmentation\":") << fragmentation
+        << F(",\"loopsPerSec\":") << GetLoopRate(now)
+        << F(",\"eventHighWater\":") << (unsigned long)eventHighWater
+        << F(",\"timerHighWater\":") << (unsigned long)timers.GetHighWater()
+        << F(",\"timerFailures\":") << timers.GetFailures()
+        << F(",\"arenaHighWater\":") << (unsigned long)arena.GetHighWater()
+        << F(",\"arenaFallbacks\":") << arena.GetFallbacks()
+        << F(",\"arenaLeaks\":") << arena.GetLeaks() << '}';
+}
@@ -0,0 +1,42 @@
+#ifndef _HEALTHMETRICS_HPP_
+#define _HEALTHMETRICS_HPP_
+
+#include <Arduino.h>
+#include "Message.hpp"
+#include "TimerWheel.hpp"
+#include "StringBuilder.hpp"
+
+
+// counters of the gateway health, cheap enough to be always on.
+// the frame counters are taken from the input message, heap values are sampled on report.
+class HealthMetrics
+{
+    public:
+
+        HealthMetrics(const Message& input, const TimerWheel& timers);
+
+        void OnLoop()                       { loops++; }
+        void OnEventQueue(size_t size)      { if (eventHighWater < size) eventHighWater = size; }
+        void OnPublish(bool sent)           { if (!sent) publishFailures++; }
+        void OnPublishSuppressed()          { publishSuppressed++; }
+        void OnFrameSkipped()               { skippedFrames++; }
+
+        uint32_t GetPublishFailures() const;
+        size_t GetEventHighWater() const;
+        uint32_t GetLoopRate(unsigned long now);   // loop iterations per second since the last call
+
+        void WriteStatsJson(StringBuilder& json, unsigned long now);
+
+    private:
+
+        const Message& input;
+        const TimerWheel& timers;
+        uint32_t       loops;
+        unsigned long  loopsSince;
+        uint32_t       publishFailures;
+        uint32_t       publishSuppressed;
+        uint32_t       skippedFrames;
+        size_t         eventHighWater;
+};
+
+#endif // _HEALTHMETRICS_HPP_
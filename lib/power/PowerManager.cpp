@@ -0,0 +1,128 @@
+#include "PowerManager.hpp"
+
+#ifdef ESP32
+#ifdef EBC_LIGHT_SLEEP
+#include <esp_pm.h>
+#endif
+#else
+#include <ESP8266WiFi.h>
+#endif
+
+
+PowerManager::PowerManager()
+    : idle(false), waitStart(0), wokeAt(0), wokeByWork(false), sleptMs(0), loadSince(0),
+      wakeLatency(0), maxWakeLatency(0)
+{
+}
+
+void PowerManager::Begin()
+{
+    loadSince = millis();
+#if defined(ESP32) && defined(EBC_LIGHT_SLEEP)
+    // only effective if the core is build with tickless idle, wifi stays connected (dtim)
+    esp_pm_config_esp32_t pm;
+    pm.max_freq_mhz = ACTIVE_CPU_MHZ;
+    pm.min_freq_mhz = IDLE_CPU_MHZ;
+    pm.light_sleep_enable = true;
+    esp_pm_configure(&pm);
+#endif
+#ifdef ESP8266
+    // the radio sleeps between the dtim beacons, the cpu keeps polling the uart
+    WiFi.setSleepMode(WIFI_MODEM_SLEEP);
+#endif
+}
+
+void PowerManager::SetIdle(bool i)
+{
+    if (idle == i) {
+        return;
+    }
+    idle = i;
+#ifdef ESP32
+    // the apb clock stays at 80MHz down to 80MHz cpu clock, the uart baud rate is not affected
+    setCpuFrequencyMhz(idle ? IDLE_CPU_MHZ : ACTIVE_CPU_MHZ);
+#endif
+}
+
+bool PowerManager::IsIdle() const
+{
+    return idle;
+}
+
+PowerManager::WakeReason PowerManager::Wait(unsigned long timeout, WorkPending work)
+{
+    if (MAX_WAIT_MS < timeout) {
+        timeout = MAX_WAIT_MS;
+    }
+    waitStart = millis();
+    WakeReason reason = Wake_Timeout;
+    while (true) {
+        if (work()) {
+            reason = Wake_Work;
+            break; // while
+        }
+        if (timeout <= (millis() - waitStart)) {
+            break; // while
+        }
+        // yields to the os: the idle task may sleep (ESP32 automatic light sleep),
+        // on the ESP8266 only the radio sleeps
+        delay(1);
+    }
+    wokeAt = millis();
+    wokeByWork = (reason == Wake_Work) && (waitStart != wokeAt);
+    sleptMs += wokeAt - waitStart;
+    return reason;
+}
+
+void PowerManager::OnFrame(unsigned long now)
+{
+    if (!wokeByWork) {
+        return; // the frame was not the reason to wake up
+    }
+    wokeByWork = false;
+    wakeLatency = now - wokeAt;
+    if (maxWakeLatency < wakeLatency) {
+        maxWakeLatency = wakeLatency;
+    }
+}
+
+uint32_t PowerManager::GetCpuMHz() const
+{
+#ifdef ESP32
+    return getCpuFrequencyMhz();
+#else
+    return ESP.getCpuFreqMHz();
+#endif
+}
+
+uint8_t PowerManager::GetLoad()
+{
+    unsigned long now = millis();
+    unsigned long total = now - loadSince;
+    uint8_t load = 0;
+    if (0 < total && sleptMs <= total) {
+        load = (uint8_t)(100 - (sleptMs * 100) / total);
+    }
+    loadSince = now;
+    sleptMs = 0;
+    return load;
+}
+
+unsigned long PowerManager::GetWakeLatency() const
+{
+    return wakeLatency;
+}
+
+unsigned long PowerManager::GetMaxWakeLatency() const
+{
+    return maxWakeLatency;
+}
+
+void PowerManager::WriteStatsJson(StringBuilder& json)
+{
+    json << F("{\"cpuMHz\":") << GetCpuMHz()
+        << F(",\"idle\":") << (idle ? F("true") : F("false"))
+        << F(",\"load\":") << (unsigned)GetLoad()
+        << F(",\"wakeLatencyMs\":") << wakeLatency
+        << F(",\"maxWakeLatencyMs\":") << maxWakeLatency << '}';
+}
@@ -0,0 +1,53 @@
+#ifndef _POWERMANAGER_HPP_
+#define _POWERMANAGER_HPP_
+
+#include <Arduino.h>
+#include "StringBuilder.hpp"
+
+
+// lets the main loop sleep until there is something to do (uart data, an event
+// from mqtt or the next timer deadline) instead of busy polling.
+// on the ESP32 the cpu frequency is lowered while no charger is connected and
+// automatic light sleep is enabled if the firmware is build with EBC_LIGHT_SLEEP.
+// the ESP8266 only yields to the sdk while waiting, with the radio in modem sleep:
+// its light sleep stops the uart clock and would lose the frames of the charger.
+class PowerManager
+{
+    public:
+
+        enum WakeReason { Wake_Work, Wake_Timeout };
+
+        typedef bool (*WorkPending) ();
+
+        static const unsigned long MAX_WAIT_MS = 50;    // homie needs its loop, too
+        static const uint32_t      IDLE_CPU_MHZ = 80;   // lowest frequency with wifi
+        static const uint32_t      ACTIVE_CPU_MHZ = 240;
+
+        PowerManager();
+
+        void Begin();
+        void SetIdle(bool idle);
+        bool IsIdle() const;
+
+        WakeReason Wait(unsigned long timeout, WorkPending work);
+        void OnFrame(unsigned long now);    // a frame was parsed
+
+        uint32_t GetCpuMHz() const;
+        uint8_t GetLoad();                  // busy time of the loop since the last call (%)
+        unsigned long GetWakeLatency() const;
+        unsigned long GetMaxWakeLatency() const;
+        void WriteStatsJson(StringBuilder& json);
+
+    private:
+
+        bool          idle;
+        unsigned long waitStart;
+        unsigned long wokeAt;
+        bool          wokeByWork;
+        unsigned long sleptMs;      // since the last GetLoad()
+        unsigned long loadSince;
+        unsigned long wakeLatency;
+        unsigned long maxWakeLatency;
+};
+
+#endif // _POWERMANAGER_HPP_
@@ -0,0 +1,122 @@
+#include "Profiler.hpp"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <chrono>
+#endif
+
+
+
+Profiler::Profiler()
+{
+    Reset();
+}
+
+uint32_t Profiler::Start()
+{
+#ifdef ARDUINO
+    return ESP.getCycleCount();
+#else
+    return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+uint32_t Profiler::ToMicros(uint32_t ticks)
+{
+#ifdef ARDUINO
+    // the frequency may have changed within the scope, this is rare and accepted
+    return ticks / ESP.getCpuFreqMHz();
+#else
+    return ticks;
+#endif
+}
+
+void Profiler::Stop(ProfileStage stage, uint32_t start)
+{
+    Record(stage, ToMicros(Start() - start));   // wraps safely
+}
+
+void Profiler::Record(ProfileStage stage, uint32_t us)
+{
+    Histogram& h = stages[stage];
+    h.count++;
+    h.sumUs += us;
+    if (h.maxUs < us) {
+        h.maxUs = us;
+    }
+    size_t bucket = 0;
+    uint32_t limit = (uint32_t)1 << FIRST_BUCKET_SHIFT;
+    while ((bucket < (BUCKETS - 1)) && (limit <= us)) {
+        bucket++;
+        limit <<= 1;
+    }
+    h.buckets[bucket]++;
+}
+
+void Profiler::Reset()
+{
+    memset(stages, 0, sizeof(stages));
+}
+
+const Profiler::Histogram& Profiler::Get(ProfileStage stage) const
+{
+    return stages[stage];
+}
+
+const char* Profiler::StageName(ProfileStage stage)
+{
+    switch (stage) {
+        case Prof_Read:         return "read";
+        case Prof_Decode:       return "decode";
+        case Prof_Parameters:   return "parameters";
+        case Prof_Json:         return "json";
+        case Prof_Inject:       return "inject";
+        case Prof_Fsm:          return "fsm";
+        case Prof_Publish:      return "publish";
+        default:                return "unknown";
+    }
+}
+
+// {"read":{"n":12,"avgUs":40,"maxUs":95,"h":[0,0,10,2,0,0,0,0,0,0]},...}
+size_t Profiler::WriteJson(char* buf, size_t len) const
+{
+    size_t pos = 0;
+    auto append = [&](int n) {
+        if ((n < 0) || (len <= pos + (size_t)n)) {
+            pos = len;  // truncated
+            return false;
+        }
+        pos += n;
+        return true;
+    };
+
+    if (!append(snprintf(buf, len, "{"))) {
+        return 0;
+    }
+    for (int s = 0; s < Prof_Count; ++s) {
+        const Histogram& h = stages[s];
+        uint32_t avg = (0 < h.count) ? (uint32_t)(h.sumUs / h.count) : 0;
+        if (!append(snprintf(buf + pos, len - pos, "%s\"%s\":{\"n\":%lu,\"avgUs\":%lu,\"maxUs\":%lu,\"h\":[",
+                (0 < s) ? "," : "", StageName((ProfileStage)s),
+                (unsigned long)h.count, (unsigned long)avg, (unsigned long)h.maxUs))) {
+            return 0;
+        }
+        for (size_t b = 0; b < BUCKETS; ++b) {
+            if (!append(snprintf(buf + pos, len - pos, "%s%lu", (0 < b) ? "," : "", (unsigned long)h.buckets[b]))) {
+                return 0;
+            }
+        }
+        if (!append(snprintf(buf + pos, len - pos, "]}"))) {
+            return 0;
+        }
+    }
+    if (!append(snprintf(buf + pos, len - pos, "}"))) {
+        return 0;
+    }
+    return pos;
+}
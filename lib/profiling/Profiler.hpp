@@ -0,0 +1,94 @@
+#ifndef _PROFILER_HPP_
+#define _PROFILER_HPP_
+
+#include <stdint.h>
+#include <stddef.h>
+
+
+// stages of the hot path, measured by PROFILE_SCOPE()
+enum ProfileStage {
+    Prof_Read,          // Message::Read(), parse a frame
+    Prof_Decode,        // EbcController::GetController(response)
+    Prof_Parameters,    // EbcController::GetResponseParameters()
+    Prof_Json,          // EbcController::GetResponseJson()
+    Prof_Inject,        // Processor::InjectData()
+    Prof_Fsm,           // one event dispatched by the fsm
+    Prof_Publish,       // one property published
+    Prof_Count
+};
+
+// low overhead latency profiler with a fixed bucket histogram per stage.
+// the device uses the cpu cycle counter, the host std::chrono.
+// build with EBC_PROFILER to enable it, otherwise PROFILE_SCOPE() compiles to nothing.
+class Profiler
+{
+    public:
+
+        static const size_t  BUCKETS = 10;          // < 16us, < 32us, ... < 4096us, >= 4096us
+        static const uint8_t FIRST_BUCKET_SHIFT = 4;
+
+        struct Histogram
+        {
+            uint32_t count;
+            uint32_t maxUs;
+            uint64_t sumUs;
+            uint32_t buckets[BUCKETS];
+        };
+
+        static Profiler& GetInstance()
+        {
+            static Profiler instance;
+            return instance;
+        }
+
+        Profiler(Profiler const&) = delete;
+        void operator=(Profiler const&) = delete;
+
+        static uint32_t Start();                    // timestamp in ticks of the clock
+        void Stop(ProfileStage stage, uint32_t start);
+        void Record(ProfileStage stage, uint32_t us);
+        void Reset();
+
+        const Histogram& Get(ProfileStage stage) const;
+        static const char* StageName(ProfileStage stage);
+        size_t WriteJson(char* buf, size_t len) const;  // returns 0 if buf is too small
+
+    private:
+
+        Profiler();
+
+        static uint32_t ToMicros(uint32_t ticks);
+
+        Histogram stages[Prof_Count];
+};
+
+class ProfileScope
+{
+    public:
+
+        explicit ProfileScope(ProfileStage s)
+            : stage(s)
+            , start(Profiler::Start())
+        {
+        }
+
+        ~ProfileScope()
+        {
+            Profiler::GetInstance().Stop(stage, start);
+        }
+
+    private:
+
+        ProfileStage stage;
+        uint32_t     start;
+};
+
+#ifdef EBC_PROFILER
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(stage) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(stage)
+#else
+#define PROFILE_SCOPE(stage) do {} while (0)
+#endif
+
+#endif // _PROFILER_HPP_
@@ -0,0 +1,379 @@
+#include "Outbox.hpp"
+#include "FrameArena.hpp"
+#ifdef ESP32
+#include <SPIFFS.h>
+#else
+#include <FS.h>
+#endif
+
+// the file system of the Homie configuration, it is mounted by Homie already
+#define OUTBOX_FS SPIFFS
+
+
+
+Outbox::Outbox()
+    : head(0)
+    , tail(0)
+    , ramRecords(0)
+    , path(nullptr)
+    , maxSpill(0)
+    , spillSize(0)
+    , spillRead(0)
+    , spillFull(false)
+    , spilled(0)
+    , downsampled(0)
+    , dropped(0)
+    , sent(0)
+{
+    memset(samples, 0, sizeof(samples));
+}
+
+bool Outbox::Begin(const char* p, size_t max)
+{
+    path = nullptr;
+    maxSpill = 0;
+    spillSize = 0;
+    spillRead = 0;
+    spillFull = false;
+    if ((p == nullptr) || (max == 0) || !OUTBOX_FS.begin()) {
+        return false;
+    }
+    path = p;
+    maxSpill = max;
+    // the messages of the last run are published as well
+    if (OUTBOX_FS.exists(path)) {
+        File f = OUTBOX_FS.open(path, "r");
+        if (f) {
+            spillSize = f.size();
+            f.close();
+        }
+    }
+    return true;
+}
+
+size_t Outbox::RecordLength(const uint8_t* record)
+{
+    return HEADER_LEN + record[1] + 1 + (record[2] | (record[3] << 8)) + 1;
+}
+
+void Outbox::WriteRecord(uint8_t* p, Kind kind, const char* node, const char* property, const char* value)
+{
+    size_t nodeLen = strlen(node);
+    size_t propertyLen = strlen(property);
+    size_t valueLen = strlen(value);
+    p[0] = kind;
+    p[1] = nodeLen + 1 + propertyLen;
+    p[2] = valueLen & 0xff;
+    p[3] = valueLen >> 8;
+    p += HEADER_LEN;
+    memcpy(p, node, nodeLen);
+    p += nodeLen;
+    *p++ = '/';
+    memcpy(p, property, propertyLen + 1);
+    p += propertyLen + 1;
+    memcpy(p, value, valueLen + 1);
+}
+
+bool Outbox::Publish(PublishDelegate publish, const uint8_t* record)
+{
+    const char* topic = (const char*)record + HEADER_LEN;
+    const char* value = topic + record[1] + 1;
+    return publish(topic, value, record[0] == Kind_Result);
+}
+
+bool Outbox::IsTopic(const uint8_t* record, const char* node, const char* property)
+{
+    const char* topic = (const char*)record + HEADER_LEN;
+    size_t nodeLen = strlen(node);
+    return (record[1] == nodeLen + 1 + strlen(property))
+        && (memcmp(topic, node, nodeLen) == 0)
+        && (topic[nodeLen] == '/')
+        && (strcmp(topic + nodeLen + 1, property) == 0);
+}
+
+uint8_t Outbox::GetPressure() const
+{
+    size_t used = (tail - head) + (spillSize - spillRead);
+    size_t capacity = RAM_SIZE;
+    if (path != nullptr) {
+        // a full file system takes no more than what is written already
+        capacity += spillFull ? spillSize : maxSpill;
+    }
+    if (capacity <= used) {
+        return 4;
+    }
+    return (used * 4) / capacity;
+}
+
+// telemetry is thinned out per property: the interval doubles with each pressure level
+bool Outbox::Accept(const char* node, const char* property, unsigned long now)
+{
+    uint8_t pressure = GetPressure();
+    if (pressure == 0) {
+        return true;
+    }
+    if (3 <= pressure) {
+        dropped++;
+        return false;
+    }
+    // FNV-1a
+    uint32_t key = 2166136261UL;
+    for (const char* s = node; *s != '\0'; ++s) {
+        key = (key ^ (uint8_t)*s) * 16777619UL;
+    }
+    for (const char* s = property; *s != '\0'; ++s) {
+        key = (key ^ (uint8_t)*s) * 16777619UL;
+    }
+    Sample& sample = samples[key % MAX_SAMPLES];
+    if ((sample.key == key) && ((now - sample.accepted) < (DOWNSAMPLE_MS << (pressure - 1)))) {
+        downsampled++;
+        return false;
+    }
+    sample.key = key;
+    sample.accepted = now;
+    return true;
+}
+
+bool Outbox::Add(Kind kind, const char* node, const char* property, const char* value, unsigned long now)
+{
+    if ((kind == Kind_Telemetry) && !Accept(node, property, now)) {
+        return false;
+    }
+    size_t topicLen = strlen(node) + 1 + strlen(property);
+    size_t valueLen = strlen(value);
+    if ((255 < topicLen) || (0xffff < valueLen)) {
+        dropped++;
+        return false;
+    }
+    size_t len = HEADER_LEN + topicLen + 1 + valueLen + 1;
+
+    if (kind == Kind_Result) {
+        Coalesce(node, property);
+    }
+    if (RAM_SIZE - tail < len) {
+        Compact();
+    }
+    if (RAM_SIZE - tail < len) {
+        // the older messages go to flash first, so the order is kept
+        if (!Spill()) {
+            if ((kind != Kind_Result) || !EvictTelemetry(len)) {
+                dropped++;
+                return false;
+            }
+        }
+        else if (RAM_SIZE < len) {
+            uint8_t* record = (uint8_t*)FrameArena::GetInstance().Allocate(len);
+            if (record == nullptr) {
+                dropped++;
+                return false;
+            }
+            WriteRecord(record, kind, node, property, value);
+            bool ok = AppendToSpill(record, len);
+            FrameArena::GetInstance().Free(record);
+            if (!ok) {
+                dropped++;
+                return false;
+            }
+            spilled++;
+            return true;
+        }
+    }
+    WriteRecord(ram + tail, kind, node, property, value);
+    tail += len;
+    ramRecords++;
+    return true;
+}
+
+void Outbox::Compact()
+{
+    if (0 < head) {
+        memmove(ram, ram + head, tail - head);
+        tail -= head;
+        head = 0;
+    }
+}
+
+void Outbox::Remove(size_t at)
+{
+    size_t len = RecordLength(ram + at);
+    memmove(ram + at, ram + at + len, tail - at - len);
+    tail -= len;
+    ramRecords--;
+}
+
+// a result is retained, only the newest value of a topic is of use.
+// the spill file is not rewritten, the newer value is published after it
+void Outbox::Coalesce(const char* node, const char* property)
+{
+    for (size_t at = head; at < tail; at += RecordLength(ram + at)) {
+        if ((ram[at] == Kind_Result) && IsTopic(ram + at, node, property)) {
+            Remove(at);
+            return;
+        }
+    }
+}
+
+// drops the oldest telemetry until len bytes are free, false if that is not enough
+bool Outbox::EvictTelemetry(size_t len)
+{
+    if (RAM_SIZE < len) {
+        return false;
+    }
+    size_t at = head;
+    while ((RAM_SIZE - (tail - head) < len) && (at < tail)) {
+        if (ram[at] == Kind_Telemetry) {
+            Remove(at);
+            dropped++;
+        }
+        else {
+            at += RecordLength(ram + at);
+        }
+    }
+    Compact();
+    return len <= RAM_SIZE - tail;
+}
+
+bool Outbox::Spill()
+{
+    if (head == tail) {
+        return true;
+    }
+    if (!AppendToSpill(ram + head, tail - head)) {
+        return false;
+    }
+    spilled += ramRecords;
+    ramRecords = 0;
+    head = 0;
+    tail = 0;
+    return true;
+}
+
+bool Outbox::AppendToSpill(const uint8_t* data, size_t len)
+{
+    if ((path == nullptr) || spillFull || (maxSpill < spillSize + len)) {
+        return false;
+    }
+    File f = OUTBOX_FS.open(path, "a");
+    if (!f) {
+        return false;
+    }
+    size_t num = f.write(data, len);
+    f.close();
+    if (num < len) {
+        // the file system is full, a partly written record is never read
+        spillFull = true;
+        return false;
+    }
+    spillSize += len;
+    return true;
+}
+
+// false if a message could not be published
+bool Outbox::FlushSpill(PublishDelegate publish, size_t& n, size_t& bytes, size_t maxRecords, size_t maxBytes)
+{
+    bool ok = true;
+    File f = OUTBOX_FS.open(path, "r");
+    if (!f || !f.seek(spillRead)) {
+        spillRead = spillSize;  // the file is lost
+    }
+    while (ok && (n < maxRecords) && (bytes < maxBytes) && (spillRead < spillSize)) {
+        uint8_t header[HEADER_LEN];
+        size_t len = 0;
+        if (f.read(header, HEADER_LEN) == HEADER_LEN) {
+            len = RecordLength(header);
+        }
+        uint8_t* record = (HEADER_LEN < len) && (len <= spillSize - spillRead)
+            ? (uint8_t*)FrameArena::GetInstance().Allocate(len) : nullptr;
+        if ((record == nullptr) || (f.read(record + HEADER_LEN, len - HEADER_LEN) != len - HEADER_LEN)) {
+            FrameArena::GetInstance().Free(record);
+            spillRead = spillSize;  // a broken file is given up
+            break;
+        }
+        memcpy(record, header, HEADER_LEN);
+        ok = Publish(publish, record);
+        FrameArena::GetInstance().Free(record);
+        if (ok) {
+            spillRead += len;
+            bytes += len;
+            n++;
+        }
+    }
+    if (f) {
+        f.close();
+    }
+    if (spillSize <= spillRead) {
+        OUTBOX_FS.remove(path);
+        spillSize = 0;
+        spillRead = 0;
+        spillFull = false;
+    }
+    return ok;
+}
+
+size_t Outbox::Flush(PublishDelegate publish, size_t maxRecords, size_t maxBytes)
+{
+    size_t n = 0;
+    size_t bytes = 0;
+    bool ok = true;
+    if ((path != nullptr) && (spillRead < spillSize)) {
+        ok = FlushSpill(publish, n, bytes, maxRecords, maxBytes);
+    }
+    // the ram holds the newer messages, it is published after the spill file
+    while (ok && (spillSize == 0) && (n < maxRecords) && (bytes < maxBytes) && (head < tail)) {
+        const uint8_t* record = ram + head;
+        ok = Publish(publish, record);
+        if (ok) {
+            size_t len = RecordLength(record);
+            head += len;
+            bytes += len;
+            ramRecords--;
+            n++;
+        }
+    }
+    if (head == tail) {
+        head = 0;
+        tail = 0;
+    }
+    sent += n;
+    return n;
+}
+
+bool Outbox::IsEmpty() const
+{
+    return (head == tail) && (spillSize <= spillRead);
+}
+
+size_t Outbox::GetPending() const
+{
+    return (tail - head) + (spillSize - spillRead);
+}
+
+uint32_t Outbox::GetSpilled() const
+{
+    return spilled;
+}
+
+uint32_t Outbox::GetDownsampled() const
+{
+    return downsampled;
+}
+
+uint32_t Outbox::GetDropped() const
+{
+    return dropped;
+}
+
+uint32_t Outbox::GetSent() const
+{
+    return sent;
+}
+
+void Outbox::WriteStatsJson(StringBuilder& json) const
+{
+    json << F("{\"pending\":") << (unsigned long)GetPending()
+        << F(",\"pressure\":") << (unsigned)GetPressure()
+        << F(",\"spilled\":") << spilled
+        << F(",\"downsampled\":") << downsampled
+        << F(",\"dropped\":") << dropped
+        << F(",\"sent\":") << sent << '}';
+}
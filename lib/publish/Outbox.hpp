@@ -0,0 +1,92 @@
+#ifndef _OUTBOX_HPP_
+#define _OUTBOX_HPP_
+
+#include <Arduino.h>
+#include "StringBuilder.hpp"
+
+#ifndef OUTBOX_RAM_SIZE
+#define OUTBOX_RAM_SIZE 2048
+#endif
+
+
+// keeps the messages that could not be published while wifi or the broker were gone.
+// the messages are collected in ram, a full ram buffer is appended to a spill file on
+// flash. Flush() publishes the oldest messages first: the spill file, then the ram.
+// results are always kept as long as there is space, a queued result is replaced by a
+// newer one of the same topic. telemetry is downsampled if the buffer fills up and
+// dropped for the last quarter, which is left to the results. without flash the
+// telemetry in ram is dropped to make room for a result.
+//   record: <kind> <topic length> <value length, 2 bytes> <topic>\0<value>\0
+class Outbox
+{
+    public:
+
+        enum Kind { Kind_Telemetry, Kind_Result };
+
+        static const size_t RAM_SIZE = OUTBOX_RAM_SIZE;
+        static const unsigned long DOWNSAMPLE_MS = 10000;  // min telemetry interval at the first pressure level
+
+        // topic is "<node>/<property>", a replayed telemetry value is not retained
+        typedef bool (*PublishDelegate) (const char* topic, const char* value, bool retained);
+
+        Outbox();
+
+        bool Begin(const char* path, size_t maxSpill);  // 0 = ram only, an existing spill file is kept
+        bool Add(Kind kind, const char* node, const char* property, const char* value, unsigned long now);
+        size_t Flush(PublishDelegate publish, size_t maxRecords, size_t maxBytes);  // number of published messages
+
+        bool IsEmpty() const;
+        size_t GetPending() const;      // bytes in ram and on flash
+        uint8_t GetPressure() const;    // 0 (< 1/4 of ram and flash used) .. 4 (full)
+
+        uint32_t GetSpilled() const;    // messages moved to flash
+        uint32_t GetDownsampled() const;
+        uint32_t GetDropped() const;
+        uint32_t GetSent() const;
+        void WriteStatsJson(StringBuilder& json) const;
+
+    private:
+
+        static const size_t HEADER_LEN = 4;
+        static const size_t MAX_SAMPLES = 8;
+
+        struct Sample
+        {
+            uint32_t      key;
+            unsigned long accepted;
+        };
+
+        static size_t RecordLength(const uint8_t* record);
+        static void WriteRecord(uint8_t* p, Kind kind, const char* node, const char* property, const char* value);
+        static bool Publish(PublishDelegate publish, const uint8_t* record);
+        static bool IsTopic(const uint8_t* record, const char* node, const char* property);
+
+        bool Accept(const char* node, const char* property, unsigned long now);
+        bool Spill();
+        bool AppendToSpill(const uint8_t* data, size_t len);
+        bool FlushSpill(PublishDelegate publish, size_t& n, size_t& bytes, size_t maxRecords, size_t maxBytes);
+        void Compact();
+        void Remove(size_t at);
+        void Coalesce(const char* node, const char* property);
+        bool EvictTelemetry(size_t len);
+
+        uint8_t  ram[RAM_SIZE];
+        size_t   head;          // the oldest record in ram
+        size_t   tail;
+        size_t   ramRecords;    // between head and tail
+
+        const char* path;
+        size_t   maxSpill;
+        size_t   spillSize;     // bytes written to the spill file
+        size_t   spillRead;     // bytes of the spill file already published
+        bool     spillFull;     // the file system is full
+
+        Sample   samples[MAX_SAMPLES];
+
+        uint32_t spilled;
+        uint32_t downsampled;
+        uint32_t dropped;
+        uint32_t sent;
+};
+
+#endif // _OUTBOX_HPP_
@@ -0,0 +1,76 @@
+#include "PublishCache.hpp"
+
+
+
+PublishCache::PublishCache()
+    : size(0)
+    , keepAlive(0)
+{
+}
+
+void PublishCache::SetKeepAlive(unsigned long ms)
+{
+    keepAlive = ms;
+}
+
+// FNV-1a
+uint32_t PublishCache::Hash(uint32_t h, const char* s)
+{
+    while (*s != '\0') {
+        h = (h ^ (uint8_t)*s++) * 16777619UL;
+    }
+    return h;
+}
+
+uint32_t PublishCache::Key(const char* node, const char* property)
+{
+    return Hash(Hash(Hash(2166136261UL, node), "/"), property);
+}
+
+PublishCache::Entry* PublishCache::Find(uint32_t key)
+{
+    for (size_t i = 0; i < size; ++i) {
+        if (entries[i].key == key) {
+            return &entries[i];
+        }
+    }
+    return nullptr;
+}
+
+bool PublishCache::Check(const char* node, const char* property, const String& value, unsigned long now)
+{
+    return Check(node, property, value.c_str(), now);
+}
+
+bool PublishCache::Check(const char* node, const char* property, const char* value, unsigned long now)
+{
+    uint32_t key = Key(node, property);
+    uint32_t hash = Hash(2166136261UL, value);
+    Entry* e = Find(key);
+    if (e == nullptr) {
+        if (MAX_ENTRIES <= size) {
+            return true;
+        }
+        e = &entries[size++];
+        e->key = key;
+    } else
+    if ((e->value == hash) && ((keepAlive == 0) || ((now - e->published) < keepAlive))) {
+        return false;
+    }
+    e->value = hash;
+    e->published = now;
+    return true;
+}
+
+void PublishCache::Forget(const char* node, const char* property)
+{
+    Entry* e = Find(Key(node, property));
+    if (e != nullptr) {
+        *e = entries[--size];
+    }
+}
+
+void PublishCache::Clear()
+{
+    size = 0;
+}
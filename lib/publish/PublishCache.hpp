@@ -0,0 +1,44 @@
+#ifndef _PUBLISHCACHE_HPP_
+#define _PUBLISHCACHE_HPP_
+
+#include <Arduino.h>
+
+
+// remembers a hash of the last published value of each property and suppresses
+// publishing the same value again. an unchanged value is published anyway if the
+// last publish is older than the keep-alive interval.
+class PublishCache
+{
+    public:
+
+        static const size_t MAX_ENTRIES = 20;   // further properties are never suppressed
+
+        PublishCache();
+
+        void SetKeepAlive(unsigned long ms);    // 0 = never republish an unchanged value
+
+        // true if the value has to be published, it is recorded as published then
+        bool Check(const char* node, const char* property, const char* value, unsigned long now);
+        bool Check(const char* node, const char* property, const String& value, unsigned long now);
+        void Forget(const char* node, const char* property);    // the publish failed
+        void Clear();                                           // publish all values again
+
+    private:
+
+        struct Entry
+        {
+            uint32_t      key;
+            uint32_t      value;
+            unsigned long published;
+        };
+
+        static uint32_t Hash(uint32_t h, const char* s);
+        static uint32_t Key(const char* node, const char* property);
+        Entry* Find(uint32_t key);
+
+        Entry         entries[MAX_ENTRIES];
+        size_t        size;
+        unsigned long keepAlive;
+};
+
+#endif // _PUBLISHCACHE_HPP_
@@ -0,0 +1,110 @@
+#include "TelemetryPolicy.hpp"
+
+
+
+TelemetryPolicy::TelemetryPolicy(uint32_t deadband, uint16_t relative, unsigned long minInterval, unsigned long slowInterval, unsigned long maxInterval)
+    : policy{deadband, relative, minInterval, slowInterval, maxInterval}
+    , published(false)
+    , last(0)
+    , lastTime(0)
+    , suppressed(0)
+{
+}
+
+void TelemetryPolicy::Set(const Policy& p)
+{
+    policy = p;
+}
+
+const TelemetryPolicy::Policy& TelemetryPolicy::Get() const
+{
+    return policy;
+}
+
+bool TelemetryPolicy::SetFromJson(JsonVariantConst json)
+{
+    if (!json.is<JsonObjectConst>()) {
+        return false;
+    }
+    Policy p = policy;
+    if (json.containsKey("deadband")) {
+        p.deadband = json["deadband"].as<uint32_t>();
+    }
+    if (json.containsKey("relative")) {
+        p.relative = json["relative"].as<uint16_t>();
+    }
+    if (json.containsKey("minMs")) {
+        p.minInterval = json["minMs"].as<unsigned long>();
+    }
+    if (json.containsKey("slowMs")) {
+        p.slowInterval = json["slowMs"].as<unsigned long>();
+    }
+    if (json.containsKey("maxMs")) {
+        p.maxInterval = json["maxMs"].as<unsigned long>();
+    }
+    if ((0 < p.maxInterval) && (p.maxInterval < p.minInterval)) {
+        return false;
+    }
+    policy = p;
+    return true;
+}
+
+void TelemetryPolicy::AddToJson(JsonObject obj) const
+{
+    obj["deadband"] = policy.deadband;
+    obj["relative"] = policy.relative;
+    obj["minMs"] = policy.minInterval;
+    obj["slowMs"] = policy.slowInterval;
+    obj["maxMs"] = policy.maxInterval;
+}
+
+bool TelemetryPolicy::Check(int32_t milli, unsigned long now, bool fast)
+{
+    if (!published) {
+        Publish(milli, now);
+        return true;
+    }
+    unsigned long elapsed = now - lastTime;
+    if ((0 < policy.maxInterval) && (policy.maxInterval <= elapsed)) {
+        Publish(milli, now);    // heartbeat
+        return true;
+    }
+    unsigned long minInterval = (!fast && (policy.minInterval < policy.slowInterval)) ? policy.slowInterval : policy.minInterval;
+    if (elapsed < minInterval) {
+        if (milli != last) {
+            suppressed++;
+        }
+        return false;
+    }
+    uint32_t delta = (milli < last) ? (uint32_t)(last - milli) : (uint32_t)(milli - last);
+    uint32_t magnitude = (last < 0) ? (uint32_t)(-(int64_t)last) : (uint32_t)last;
+    uint32_t threshold = (uint32_t)(((uint64_t)magnitude * policy.relative) / 1000);
+    if (threshold < policy.deadband) {
+        threshold = policy.deadband;
+    }
+    if (delta <= threshold) {
+        if (0 < delta) {
+            suppressed++;
+        }
+        return false;
+    }
+    Publish(milli, now);
+    return true;
+}
+
+void TelemetryPolicy::Publish(int32_t milli, unsigned long now)
+{
+    published = true;
+    last = milli;
+    lastTime = now;
+}
+
+void TelemetryPolicy::Reset()
+{
+    published = false;
+}
+
+uint32_t TelemetryPolicy::GetSuppressed() const
+{
+    return suppressed;
+}
@@ -0,0 +1,48 @@
+#ifndef _TELEMETRYPOLICY_HPP_
+#define _TELEMETRYPOLICY_HPP_
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+
+// decides if a new value of a telemetry property is worth to be published.
+// the values are compared in integer milli units (mV, mA, mAh): a value is published
+// if it leaves the deadband around the last published one, but not before the minimum
+// interval. at the low rate the slow interval is the minimum interval, see TelemetryRate.
+// an unchanged value is published again after the maximum interval.
+class TelemetryPolicy
+{
+    public:
+
+        struct Policy
+        {
+            uint32_t      deadband;     // absolute, in milli units
+            uint16_t      relative;     // relative to the last published value, in permille
+            unsigned long minInterval;  // ms, 0 = every change
+            unsigned long slowInterval; // ms, the minimum interval at the low rate
+            unsigned long maxInterval;  // ms, 0 = no heartbeat
+        };
+
+        TelemetryPolicy(uint32_t deadband, uint16_t relative, unsigned long minInterval, unsigned long slowInterval, unsigned long maxInterval);
+
+        void Set(const Policy& p);
+        const Policy& Get() const;
+        bool SetFromJson(JsonVariantConst json);    // {"deadband":5,"relative":0,"minMs":1000,"slowMs":10000,"maxMs":60000}, all keys optional
+        void AddToJson(JsonObject obj) const;
+
+        bool Check(int32_t milli, unsigned long now, bool fast = true); // true if the value has to be published, it is recorded then
+        void Publish(int32_t milli, unsigned long now); // the value is published anyway
+        void Reset();                                   // the next value is published
+
+        uint32_t GetSuppressed() const;
+
+    private:
+
+        Policy        policy;
+        bool          published;
+        int32_t       last;
+        unsigned long lastTime;
+        uint32_t      suppressed;
+};
+
+#endif // _TELEMETRYPOLICY_HPP_
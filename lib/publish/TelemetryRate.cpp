@@ -0,0 +1,64 @@
+#include "TelemetryRate.hpp"
+
+
+
+TelemetryRate::TelemetryRate(unsigned long w, uint32_t n)
+    : window(w)
+    , near(n)
+    , event(false)
+    , eventTime(0)
+    , numThresholds(0)
+{
+}
+
+bool TelemetryRate::SetFromJson(JsonVariantConst json)
+{
+    if (json.containsKey("fastMs")) {
+        window = json["fastMs"].as<unsigned long>();
+    }
+    if (json.containsKey("nearMv")) {
+        near = json["nearMv"].as<uint32_t>();
+    }
+    return true;
+}
+
+void TelemetryRate::AddToJson(JsonObject obj) const
+{
+    obj["fastMs"] = window;
+    obj["nearMv"] = near;
+}
+
+void TelemetryRate::OnEvent(unsigned long now)
+{
+    event = true;
+    eventTime = now;
+}
+
+void TelemetryRate::SetThresholds(const int32_t* milli, size_t n)
+{
+    numThresholds = 0;
+    for (size_t i = 0; (i < n) && (numThresholds < MAX_THRESHOLDS); ++i) {
+        if (0 < milli[i]) {
+            thresholds[numThresholds++] = milli[i];
+        }
+    }
+}
+
+void TelemetryRate::ClearThresholds()
+{
+    numThresholds = 0;
+}
+
+bool TelemetryRate::IsFast(unsigned long now, int32_t voltageMilli) const
+{
+    if (event && ((now - eventTime) < window)) {
+        return true;
+    }
+    for (size_t i = 0; i < numThresholds; ++i) {
+        int32_t delta = voltageMilli - thresholds[i];
+        if (((delta < 0) ? -delta : delta) <= (int32_t)near) {
+            return true;
+        }
+    }
+    return false;
+}
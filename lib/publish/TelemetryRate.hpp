@@ -0,0 +1,38 @@
+#ifndef _TELEMETRYRATE_HPP_
+#define _TELEMETRYRATE_HPP_
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+
+// selects the full telemetry rate around interesting moments: for a while after a
+// step starts or ends or the mode of the charger changes, and while the voltage is
+// near a threshold of the active step. otherwise the low rate is used.
+class TelemetryRate
+{
+    public:
+
+        static const size_t MAX_THRESHOLDS = 2;    // voltageV and cutoffV of a step
+
+        TelemetryRate(unsigned long window, uint32_t near);
+
+        bool SetFromJson(JsonVariantConst json);    // {"fastMs":30000,"nearMv":50}, all keys optional
+        void AddToJson(JsonObject obj) const;
+
+        void OnEvent(unsigned long now);            // full rate for the next window
+        void SetThresholds(const int32_t* milli, size_t n);
+        void ClearThresholds();
+
+        bool IsFast(unsigned long now, int32_t voltageMilli) const;
+
+    private:
+
+        unsigned long window;       // ms
+        uint32_t      near;         // mV
+        bool          event;
+        unsigned long eventTime;
+        int32_t       thresholds[MAX_THRESHOLDS];
+        size_t        numThresholds;
+};
+
+#endif // _TELEMETRYRATE_HPP_
@@ -0,0 +1,73 @@
+#include "TelemetryRecord.hpp"
+#include "StringBuilder.hpp"
+
+
+
+TelemetryRecord::TelemetryRecord()
+    : length(0)
+{
+    topic[0] = '\0';
+    record[0] = '\0';
+}
+
+bool TelemetryRecord::SetTopic(const char* baseTopic, const char* deviceId, const char* node, const char* property)
+{
+    int n = snprintf(topic, sizeof(topic), "%s%s/%s/%s", baseTopic, deviceId, node, property);
+    if ((n < 0) || (sizeof(topic) <= (size_t)n)) {
+        topic[0] = '\0';
+        return false;
+    }
+    return true;
+}
+
+const char* TelemetryRecord::GetTopic() const
+{
+    return topic;
+}
+
+bool TelemetryRecord::Build(unsigned long now, const char* mode, int step, const std::vector<Parameter>& parameters)
+{
+    StringBuilder b(record, sizeof(record));
+    b << "{\"t\":" << now << ",\"m\":\"" << mode << "\",\"s\":" << step;
+
+    const char* keys[] = { ParameterName::voltageV, ParameterName::currentA, ParameterName::capacityAh };
+    const char* fragments[] = { ",\"v\":", ",\"i\":", ",\"c\":" };
+    for (size_t k = 0; k < 3; ++k) {
+        for (const auto& p : parameters) {
+            if (p.name == keys[k]) {
+                (b << fragments[k]).AddFixed(p.value, 3);
+                break;
+            }
+        }
+    }
+
+    bool first = true;
+    for (const auto& p : parameters) {
+        if ((p.packing == PP_None) || (p.name == keys[0]) || (p.name == keys[1]) || (p.name == keys[2])) {
+            continue;
+        }
+        (b << (first ? ",\"set\":{\"" : ",\"") << p.name << "\":").AddFixed(p.value, 3);
+        first = false;
+    }
+    if (!first) {
+        b << '}';
+    }
+    b << '}';
+    if (b.IsTruncated()) {
+        length = 0;
+        record[0] = '\0';
+        return false;
+    }
+    length = b.Length();
+    return true;
+}
+
+const char* TelemetryRecord::GetRecord() const
+{
+    return record;
+}
+
+size_t TelemetryRecord::GetLength() const
+{
+    return length;
+}
@@ -0,0 +1,36 @@
+#ifndef _TELEMETRYRECORD_HPP_
+#define _TELEMETRYRECORD_HPP_
+
+#include <Arduino.h>
+#include <vector>
+#include "Parameter.hpp"
+
+
+// a compact record of all telemetry, built into a preallocated buffer and published
+// with a single mqtt message instead of one message per property.
+// {"t":123456,"m":"C-CV (active)","s":2,"v":4.012,"i":0.350,"c":1.234,"set":{"currentSetA":0.350,"voltageSetV":4.200,"cutoffA":0.100}}
+class TelemetryRecord
+{
+    public:
+
+        static const size_t MAX_TOPIC_LEN = 96;
+        static const size_t MAX_RECORD_LEN = 256;
+
+        TelemetryRecord();
+
+        bool SetTopic(const char* baseTopic, const char* deviceId, const char* node, const char* property);
+        const char* GetTopic() const;
+
+        // set-points are all parameters except voltage, current and capacity
+        bool Build(unsigned long now, const char* mode, int step, const std::vector<Parameter>& parameters);
+        const char* GetRecord() const;
+        size_t GetLength() const;
+
+    private:
+
+        char   topic[MAX_TOPIC_LEN];
+        char   record[MAX_RECORD_LEN];
+        size_t length;
+};
+
+#endif // _TELEMETRYRECORD_HPP_
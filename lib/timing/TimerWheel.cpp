@@ -0,0 +1,243 @@
+#include "TimerWheel.hpp"
+#include "Logger.hpp"
+
+static_assert(TimerWheel::MAX_TIMERS <= (1 << TimerWheel::INDEX_BITS), "timer index does not fit into a TimerId");
+static_assert(TimerWheel::MAX_TIMERS <= 127, "timer index does not fit into int8_t");
+
+// the generation bits of a TimerId, one bit less than left by the index, so that
+// the largest id + 1 does not wrap to InvalidTimer
+static const uint16_t GENERATION_MASK = (1 << (15 - TimerWheel::INDEX_BITS)) - 1;
+static const uint16_t INDEX_MASK = (1 << TimerWheel::INDEX_BITS) - 1;
+
+
+TimerWheel::TimerWheel(Clock c)
+    : clock(c), pending(0), highWater(0), failures(0)
+{
+    for (size_t l = 0; l < LEVELS; l++) {
+        for (size_t s = 0; s < SLOTS; s++) {
+            slots[l][s] = -1;
+        }
+    }
+    for (size_t i = 0; i < MAX_TIMERS; i++) {
+        nodes[i].used = false;
+        nodes[i].generation = 0;
+        nodes[i].next = -1;
+    }
+    current = Now() & ~(TICK_MS - 1);
+}
+
+void TimerWheel::SetClock(Clock c)
+{
+    // only allowed while no timer is pending, the wheel restarts at the new time
+    clock = c;
+    current = Now() & ~(TICK_MS - 1);
+}
+
+unsigned long TimerWheel::Now() const
+{
+    return clock();
+}
+
+TimerWheel::TimerId TimerWheel::MakeId(int8_t index) const
+{
+    // the generation makes an id of a fired or canceled timer invalid
+    return (TimerId)((((nodes[index].generation & GENERATION_MASK) << INDEX_BITS) | (index & INDEX_MASK)) + 1);
+}
+
+int8_t TimerWheel::FindIndex(TimerId id) const
+{
+    if (id == InvalidTimer) {
+        return -1;
+    }
+    int8_t index = (id - 1) & INDEX_MASK;
+    if ((MAX_TIMERS <= (size_t)index) || !nodes[index].used || MakeId(index) != id) {
+        return -1;
+    }
+    return index;
+}
+
+TimerWheel::TimerId TimerWheel::In(unsigned long ms, Handler handler, void *arg)
+{
+    for (size_t i = 0; i < MAX_TIMERS; i++) {
+        Node& n = nodes[i];
+        if (!n.used) {
+            n.used = true;
+            n.generation++;
+            n.expires = Now() + ms;
+            n.handler = handler;
+            n.arg = arg;
+            Place(i);
+            pending++;
+            if (highWater < pending) {
+                highWater = pending;
+            }
+            return MakeId(i);
+        }
+    }
+    failures++;
+    DLOGE("timer wheel: all %u timers in use", (unsigned)MAX_TIMERS);
+    return InvalidTimer;
+}
+
+bool TimerWheel::Cancel(TimerId id)
+{
+    int8_t index = FindIndex(id);
+    if (index < 0) {
+        return false;
+    }
+    Unlink(index);
+    nodes[index].used = false;
+    pending--;
+    return true;
+}
+
+void TimerWheel::CancelAll(void *arg)
+{
+    for (size_t i = 0; i < MAX_TIMERS; i++) {
+        if (nodes[i].used && nodes[i].arg == arg) {
+            Unlink(i);
+            nodes[i].used = false;
+            pending--;
+        }
+    }
+}
+
+bool TimerWheel::IsPending(TimerId id) const
+{
+    return 0 <= FindIndex(id);
+}
+
+size_t TimerWheel::Pending() const
+{
+    return pending;
+}
+
+size_t TimerWheel::GetHighWater() const
+{
+    return highWater;
+}
+
+uint32_t TimerWheel::GetFailures() const
+{
+    return failures;
+}
+
+size_t TimerWheel::SlotOf(unsigned long time, size_t level)
+{
+    return (time >> (TICK_SHIFT + SLOT_BITS * level)) & (SLOTS - 1);
+}
+
+void TimerWheel::Place(int8_t index)
+{
+    // all arithmetic on differences, so the wheel survives the wrap of millis()
+    Node& n = nodes[index];
+    long delta = (long)(n.expires - current);
+    unsigned long ticks = (delta < (long)TICK_MS) ? 1 : (((unsigned long)delta + TICK_MS - 1) >> TICK_SHIFT);
+
+    size_t level = 0;
+    while ((level + 1 < LEVELS) && ((1UL << (SLOT_BITS * (level + 1))) <= ticks)) {
+        level++;
+    }
+    unsigned long range = 1UL << (SLOT_BITS * (level + 1));
+    if (range <= ticks) {
+        // beyond the wheel: park it in the farthest slot, it is cascaded again from there
+        ticks = range - 1;
+    }
+    size_t slot = SlotOf(current + (ticks << TICK_SHIFT), level);
+    n.next = slots[level][slot];
+    slots[level][slot] = index;
+}
+
+void TimerWheel::Unlink(int8_t index)
+{
+    for (size_t l = 0; l < LEVELS; l++) {
+        for (size_t s = 0; s < SLOTS; s++) {
+            int8_t* link = &slots[l][s];
+            while (*link != -1) {
+                if (*link == index) {
+                    *link = nodes[index].next;
+                    nodes[index].next = -1;
+                    return;
+                }
+                link = &nodes[*link].next;
+            }
+        }
+    }
+}
+
+void TimerWheel::Cascade(size_t level)
+{
+    size_t slot = SlotOf(current, level);
+    int8_t index = slots[level][slot];
+    slots[level][slot] = -1;
+    while (index != -1) {
+        int8_t next = nodes[index].next;
+        Place(index);
+        index = next;
+    }
+}
+
+void TimerWheel::Tick()
+{
+    unsigned long now = Now();
+    while ((long)(now - current) >= (long)TICK_MS) {
+        current += TICK_MS;
+        // refill the lower levels when a level wraps
+        for (size_t l = 1; l < LEVELS; l++) {
+            if (((current >> TICK_SHIFT) & ((1UL << (SLOT_BITS * l)) - 1)) != 0) {
+                break; // for
+            }
+            Cascade(l);
+        }
+
+        // collect the due timers first, a handler may add or cancel timers
+        int8_t   due[MAX_TIMERS];
+        uint16_t generation[MAX_TIMERS];
+        size_t   count = 0;
+
+        size_t slot = SlotOf(current, 0);
+        int8_t index = slots[0][slot];
+        slots[0][slot] = -1;
+        while (index != -1) {
+            Node& n = nodes[index];
+            int8_t next = n.next;
+            n.next = -1;
+            if ((long)(n.expires - current) > 0) {
+                Place(index); // parked timer, not due yet
+            } else {
+                due[count] = index;
+                generation[count] = n.generation;
+                count++;
+            }
+            index = next;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            Node& n = nodes[due[i]];
+            if (n.used && n.generation == generation[i]) {
+                n.used = false;
+                pending--;
+                n.handler(n.arg);
+            }
+        }
+    }
+}
+
+unsigned long TimerWheel::TimeToNext() const
+{
+    if (pending == 0) {
+        return NoDeadline;
+    }
+    unsigned long now = Now();
+    unsigned long next = NoDeadline;
+    for (size_t i = 0; i < MAX_TIMERS; i++) {
+        if (nodes[i].used) {
+            long delta = (long)(nodes[i].expires - now);
+            unsigned long d = (delta < 0) ? 0 : (unsigned long)delta;
+            if (d < next) {
+                next = d;
+            }
+        }
+    }
+    return next;
+}
@@ -0,0 +1,77 @@
+#ifndef _TIMERWHEEL_HPP_
+#define _TIMERWHEEL_HPP_
+
+#include <Arduino.h>
+
+#ifndef TIMER_WHEEL_MAX_TIMERS
+#define TIMER_WHEEL_MAX_TIMERS 24   // about 14 are pending at most, the rest is margin
+#endif
+
+// hierarchical timer wheel, the single owner of all deadlines of the gateway.
+// three levels of 32 slots with a resolution of 8ms cover about 4.3 minutes,
+// longer timers are parked in the last level and cascaded down again.
+// the clock is injectable, so a host simulation can run in accelerated time.
+class TimerWheel
+{
+    public:
+
+        typedef void (*Handler) (void *arg);
+        typedef unsigned long (*Clock) ();
+        typedef uint16_t TimerId;
+
+        static const TimerId       InvalidTimer = 0;
+        static const unsigned long NoDeadline = (unsigned long)(-1);
+
+        static const size_t        MAX_TIMERS = TIMER_WHEEL_MAX_TIMERS;
+        static const size_t        INDEX_BITS = 5;     // of a TimerId, the other bits are the generation
+        static const size_t        TICK_SHIFT = 3;
+        static const unsigned long TICK_MS = (1 << TICK_SHIFT);
+        static const size_t        SLOT_BITS = 5;
+        static const size_t        SLOTS = (1 << SLOT_BITS);
+        static const size_t        LEVELS = 3;
+
+        TimerWheel(Clock clock = millis);
+
+        void SetClock(Clock clock);
+        unsigned long Now() const;
+
+        TimerId In(unsigned long ms, Handler handler, void *arg = nullptr);     // InvalidTimer if all timers are in use
+        bool Cancel(TimerId id);
+        void CancelAll(void *arg);      // all timers of one owner
+        bool IsPending(TimerId id) const;
+
+        void Tick();                    // fires all timers that are due
+        unsigned long TimeToNext() const;   // ms until the next deadline or NoDeadline
+        size_t Pending() const;
+        size_t GetHighWater() const;    // max timers pending at once
+        uint32_t GetFailures() const;   // In() calls refused because all timers were in use
+
+    private:
+
+        struct Node
+        {
+            unsigned long expires;      // absolute time (ms)
+            Handler       handler;
+            void*         arg;
+            uint16_t      generation;
+            int8_t        next;         // index of the next node in the same slot
+            bool          used;
+        };
+
+        Clock         clock;
+        unsigned long current;          // time of the current tick (ms)
+        Node          nodes[MAX_TIMERS];
+        int8_t        slots[LEVELS][SLOTS];
+        size_t        pending;
+        size_t        highWater;
+        uint32_t      failures;
+
+        void Place(int8_t index);
+        void Unlink(int8_t index);
+        void Cascade(size_t level);
+        static size_t SlotOf(unsigned long time, size_t level);
+        TimerId MakeId(int8_t index) const;
+        int8_t FindIndex(TimerId id) const;
+};
+
+#endif // _TIMERWHEEL_HPP_
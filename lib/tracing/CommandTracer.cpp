@@ -0,0 +1,164 @@
+#include "CommandTracer.hpp"
+
+
+
+CommandTracer::CommandTracer()
+    : commands(0)
+    , retries(0)
+    , unacked(0)
+{
+    memset(traces, 0, sizeof(traces));
+    memset(&toSent, 0, sizeof(toSent));
+    memset(&toAck, 0, sizeof(toAck));
+    memset(&roundTrip, 0, sizeof(roundTrip));
+}
+
+CommandTracer::Trace* CommandTracer::Find(Command_t code)
+{
+    for (auto& t : traces) {
+        if (t.code == code) {
+            return &t;
+        }
+    }
+    return nullptr;
+}
+
+const CommandTracer::Trace* CommandTracer::GetTrace(Command_t code) const
+{
+    for (auto& t : traces) {
+        if (t.code == code) {
+            return &t;
+        }
+    }
+    return nullptr;
+}
+
+void CommandTracer::OnQueued(Command_t code, unsigned long now)
+{
+    Trace* t = Find(code);
+    if ((t != nullptr) && !t->reached[Trace_Sent]) {
+        return; // merged in the queue, keep the first timestamp
+    }
+    if (t == nullptr) {
+        // reuse a free slot or the oldest trace
+        t = &traces[0];
+        for (auto& c : traces) {
+            if (c.code == Command::InvalidCommand) {
+                t = &c;
+                break;
+            }
+            if ((long)(c.at[Trace_Queued] - t->at[Trace_Queued]) < 0) {
+                t = &c;
+            }
+        }
+    }
+    memset(t, 0, sizeof(Trace));
+    t->code = code;
+    t->at[Trace_Queued] = now;
+    t->reached[Trace_Queued] = true;
+    commands++;
+}
+
+void CommandTracer::OnSent(Command_t code, unsigned long now)
+{
+    Trace* t = Find(code);
+    if (t == nullptr) {
+        return; // not queued by the processor
+    }
+    if (t->reached[Trace_Sent]) {
+        t->retries++;
+        retries++;
+    } else {
+        Record(toSent, now - t->at[Trace_Queued]);
+    }
+    t->at[Trace_Sent] = now;
+    t->reached[Trace_Sent] = true;
+}
+
+void CommandTracer::OnAcked(Command_t code, unsigned long now)
+{
+    Trace* t = Find(code);
+    if ((t == nullptr) || !t->reached[Trace_Sent] || t->reached[Trace_Acked]) {
+        return;
+    }
+    t->at[Trace_Acked] = now;
+    t->reached[Trace_Acked] = true;
+    Record(toAck, now - t->at[Trace_Sent]);
+    Record(roundTrip, now - t->at[Trace_Queued]);
+}
+
+void CommandTracer::OnFinished(Command_t code, unsigned long now, bool stopped)
+{
+    Trace* t = Find(code);
+    if ((t == nullptr) || t->reached[Trace_Finished]) {
+        return;
+    }
+    t->at[Trace_Finished] = now;
+    t->reached[Trace_Finished] = true;
+    t->stopped = stopped;
+    if (!t->reached[Trace_Acked]) {
+        unacked++;
+    }
+}
+
+// {"sentMs":12,"ackMs":1010,"activeMs":3600000,"retries":0,"stopped":false}
+bool CommandTracer::AddTrace(JsonObject obj, Command_t code) const
+{
+    const Trace* t = GetTrace(code);
+    if (t == nullptr) {
+        return false;
+    }
+    if (t->reached[Trace_Sent]) {
+        obj["sentMs"] = t->at[Trace_Sent] - t->at[Trace_Queued];
+    }
+    if (t->reached[Trace_Acked]) {
+        obj["ackMs"] = t->at[Trace_Acked] - t->at[Trace_Sent];
+        if (t->reached[Trace_Finished]) {
+            obj["activeMs"] = t->at[Trace_Finished] - t->at[Trace_Acked];
+        }
+    }
+    obj["retries"] = t->retries;
+    obj["stopped"] = t->stopped;
+    return true;
+}
+
+void CommandTracer::Record(Histogram& h, unsigned long ms)
+{
+    h.count++;
+    if (h.maxMs < ms) {
+        h.maxMs = ms;
+    }
+    size_t bucket = 0;
+    unsigned long limit = 1UL << FIRST_BUCKET_SHIFT;
+    while ((bucket < (BUCKETS - 1)) && (limit <= ms)) {
+        bucket++;
+        limit <<= 1;
+    }
+    h.buckets[bucket]++;
+}
+
+void CommandTracer::AddHistogram(StringBuilder& json, const char* name, const Histogram& h)
+{
+    json << F(",\"") << name << F("\":{\"n\":") << h.count << F(",\"maxMs\":") << h.maxMs << F(",\"h\":[");
+    for (size_t b = 0; b < BUCKETS; ++b) {
+        if (0 < b) {
+            json << ',';
+        }
+        json << h.buckets[b];
+    }
+    json << F("]}");
+}
+
+// {"commands":5,"retries":1,"unacked":0,"sent":{"n":5,"maxMs":40,"h":[..]},"ack":{..},"roundTrip":{..}}
+void CommandTracer::WriteStatsJson(StringBuilder& json, const CommandQueue& queue) const
+{
+    json << F("{\"commands\":") << commands
+        << F(",\"retries\":") << retries
+        << F(",\"unacked\":") << unacked;
+    AddHistogram(json, "sent", toSent);
+    AddHistogram(json, "ack", toAck);
+    AddHistogram(json, "roundTrip", roundTrip);
+    json << F(",\"queue\":");
+    queue.WriteStatsJson(json);
+    json << '}';
+}
@@ -0,0 +1,75 @@
+#ifndef _COMMANDTRACER_HPP_
+#define _COMMANDTRACER_HPP_
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "Command.hpp"
+#include "CommandQueue.hpp"
+#include "StringBuilder.hpp"
+
+
+// traces the round trip of a command: queued by the processor, sent in a tx window,
+// acknowledged by the first active response and finished or stopped.
+// the latencies are aggregated into fixed bucket histograms.
+class CommandTracer
+{
+    public:
+
+        enum Stage { Trace_Queued, Trace_Sent, Trace_Acked, Trace_Finished, Trace_Count };
+
+        static const size_t  MAX_TRACES = 4;        // one per queued command code
+        static const size_t  BUCKETS = 8;           // < 16ms, < 32ms, ... < 1024ms, >= 1024ms
+        static const uint8_t FIRST_BUCKET_SHIFT = 4;
+
+        struct Trace
+        {
+            Command_t     code;
+            unsigned long at[Trace_Count];
+            bool          reached[Trace_Count];
+            uint8_t       retries;
+            bool          stopped;
+        };
+
+        struct Histogram
+        {
+            uint32_t      count;
+            unsigned long maxMs;
+            uint32_t      buckets[BUCKETS];
+        };
+
+        static CommandTracer& GetInstance()
+        {
+            static CommandTracer instance;
+            return instance;
+        }
+
+        CommandTracer(CommandTracer const&) = delete;
+        void operator=(CommandTracer const&) = delete;
+
+        void OnQueued(Command_t code, unsigned long now);
+        void OnSent(Command_t code, unsigned long now);     // a further send is a retry
+        void OnAcked(Command_t code, unsigned long now);
+        void OnFinished(Command_t code, unsigned long now, bool stopped);
+
+        const Trace* GetTrace(Command_t code) const;
+        bool AddTrace(JsonObject obj, Command_t code) const;   // latencies of a single command
+        void WriteStatsJson(StringBuilder& json, const CommandQueue& queue) const;
+
+    private:
+
+        CommandTracer();
+
+        Trace* Find(Command_t code);
+        static void Record(Histogram& h, unsigned long ms);
+        static void AddHistogram(StringBuilder& json, const char* name, const Histogram& h);
+
+        Trace     traces[MAX_TRACES];
+        Histogram toSent;       // queued -> sent
+        Histogram toAck;        // sent (last retry) -> acked
+        Histogram roundTrip;    // queued -> acked
+        uint32_t  commands;
+        uint32_t  retries;
+        uint32_t  unacked;      // finished without an acknowledge
+};
+
+#endif // _COMMANDTRACER_HPP_
@@ -1,14 +1,23 @@
 #include "Processor.hpp"
 #include "Logger.hpp"
+#include "Profiler.hpp"
+#include "CommandTracer.hpp"
+#include "StringBuilder.hpp"
+#include "FrameArena.hpp"
 
 
-Processor::Processor()
+Processor::Processor(TimerWheel& t)
 :   command(nullptr),
     report(nullptr),
+    event(nullptr),
+    stop(nullptr),
+    encoder(nullptr),
     running(false),
-    currentStep(0)
+    suspended(false),
+    stepDeferred(false),
+    currentStep(0),
+    timers(t)
 {
-    timer = timer_create_default();
 }
 
 void Processor::SetCommmander(CommandDelegate c)
@@ -26,10 +35,26 @@ void Processor::SetEventHandler(EventDelegate e)
     event = e;
 }
 
-bool Processor::Report(const String& key, const String& value)
+void Processor::SetStopHandler(StopDelegate s)
+{
+    stop = s;
+}
+
+// a stop does not queue behind other commands, it takes the fast path if there is one
+void Processor::IssueStop(const EbcController& controller)
+{
+    if (stop != nullptr) {
+        stop();
+    } else
+    if (command != nullptr) {
+        command(controller.CreateStop().GetFrame());
+    }
+}
+
+bool Processor::Report(const char* key, const char* value)
 {
     if (report == nullptr) {
-        Logger::LogD(F("report failed (nullptr)"));
+        LOGD(F("report failed (nullptr)"));
         return false;
     }
     return report(key, value);
@@ -41,6 +66,7 @@ void Processor::Clear()
         Stop();
 
     steps.clear();
+    frames.clear();
     currentStep = 0;
     results.clear();
     name = "";
@@ -51,108 +77,117 @@ void Processor::Clear()
 void Processor::Load(const EbcController& controller, const String& jsonStr)
 {
     Clear();
+    encoder = &controller;
 
-    StaticJsonDocument<1024> doc;
-    // DynamicJsonDocument doc(1024);
+    // the document is given back to the arena before the program is reported,
+    // so the binary report has the whole arena
+    {
+        FrameJsonDocument doc(1024);    // no 1k on the stack, gone with the loop iteration
 
-    DeserializationError error = deserializeJson(doc, jsonStr);
+        DeserializationError error = deserializeJson(doc, jsonStr);
 
-    if (error) {
-        Logger::LogE(String(F("deserializeJson() failed: ")) + String(error.f_str()));
-        return;
-    }
+        if (error) {
+            LOGE((StackString<128>() << F("deserializeJson() failed: ") << error.f_str()).c_str());
+            return;
+        }
 
-    name = (const char*) doc["name"];
-    JsonArray jsteps = doc["steps"];
+        name = (const char*) doc["name"];
+        JsonArray jsteps = doc["steps"];
 
-    for (JsonVariant v : jsteps) {
-        String command = v["command"];
+        for (JsonVariant v : jsteps) {
+            String command = v["command"];
 
-        if (command == "Wait") {
-            unsigned int seconds = v["seconds"];
-            if (5 <= seconds) {
-                AddStepWait(seconds);
-            } else {
-                unsigned int minutes = v["minutes"];
-                if (1 <= minutes) {
-                    AddStepWait(minutes*60);
+            if (command == "Wait") {
+                unsigned int seconds = v["seconds"];
+                if (5 <= seconds) {
+                    AddStepWait(seconds);
                 } else {
-                    Logger::LogE(String(F("program \"")) + name + F("\": invalid program step ") + steps.size() + F(": duration"));
+                    unsigned int minutes = v["minutes"];
+                    if (1 <= minutes) {
+                        AddStepWait(minutes*60);
+                    } else {
+                        LOGE((StackString<128>() << F("program \"") << name << F("\": invalid program step ") << steps.size() << F(": duration")).c_str());
+                        Clear();
+                        return;
+                    }
+                }
+            } else
+            if (command == "Cycle") {
+                unsigned int step_index = v["step"];
+                unsigned int count = v["count"];
+                if (steps.size() <= step_index) {
+                    LOGE((StackString<128>() << F("program \"") << name << F("\": invalid program step ") << steps.size() << F(": destination")).c_str());
+                    Clear();
+                    return;
+                }
+                if (((unsigned short)(-1)) < count) {
+                    LOGE((StackString<128>() << F("program \"") << name << F("\": invalid program step ") << steps.size() << F(": count")).c_str());
+                    Clear();
+                    return;
+                }
+                AddStepCycle(step_index, count);
+            } else {
+                // command: D-CC, D-CP, C-CV
+                JsonObject obj = v.as<JsonObject>();
+                if (obj.isNull()) {
+                    LOGE((StackString<128>() << F("program \"") << name << F("\": invalid program step ") << steps.size() << F(": cannot cast to object")).c_str());
+                    Clear();
+                    return;
+                }
+                auto cmd = controller.CreateCommand(obj);
+                if (cmd.GetCommand() == Command::InvalidCommand) {
+                    LOGE((StackString<128>() << F("program \"") << name << F("\": invalid program step ") << steps.size() << F(": invalid command")).c_str());
                     Clear();
                     return;
                 }
-            }
-        } else
-        if (command == "Cycle") {
-            unsigned int step_index = v["step"];
-            unsigned int count = v["count"];
-            if (steps.size() <= step_index) {
-                Logger::LogE(String(F("program \"")) + name + F("\": invalid program step ") + steps.size() + F(": destination"));
-                Clear();
-                return;
-            }
-            if (((unsigned short)(-1)) < count) {
-                Logger::LogE(String(F("program \"")) + name + F("\": invalid program step ") + steps.size() + F(": count"));
-                Clear();
-                return;
-            }
-            AddStepCycle(step_index, count);
-        } else {
-            // command: D-CC, D-CP, C-CV
-            JsonObject obj = v.as<JsonObject>();
-            if (obj.isNull()) {
-                Logger::LogE(String(F("program \"")) + name + F("\": invalid program step ") + steps.size() + F(": cannot cast to object"));
-                Clear();
-                return;
-            }
-            auto cmd = controller.CreateCommand(obj);
-            if (cmd.GetCommand() == Command::InvalidCommand) {
-                Logger::LogE(String(F("program \"")) + name + F("\": invalid program step ") + steps.size() + F(": invalid command"));
-                Clear();
-                return;
-            }
-
-            StopCondition stopCond;
 
-            JsonObject j = v["stopCondition"];
-            if (!j.isNull()) {
-                for (const auto& kv : j) {
-                    stopCond.parameterName = kv.key().c_str();
-                    // currently we do only support "capacityAh"
-                    if (stopCond.parameterName != ParameterName::capacityAh) {
-                        Logger::LogE(String(F("program \"")) + name + F("\": invalid program step ") + steps.size() + F(": invalid parameter name of stop condition"));
-                        Clear();
-                        return;
-                    }
-                    if (kv.value().is<double>()) {
-                        stopCond.kind = StopCondition::Condition_Absolute;
-                        stopCond.value = kv.value().as<double>();
-                    } else
-                    if (kv.value().is<int>()) {
-                        stopCond.kind = StopCondition::Condition_Absolute;
-                        stopCond.value = kv.value().as<int>();
-                    } else
-                    if (kv.value().is<const char*>()) {
-                        String value = kv.value().as<const char*>();
-                        stopCond.kind = StopCondition::Condition_Absolute;
-                        int pos = value.indexOf('%');
-                        if (0 <= pos) {
-                            value = value.substring(0, pos);
-                            stopCond.kind = StopCondition::Condition_Percent;
+                StopCondition stopCond;
+
+                JsonObject j = v["stopCondition"];
+                if (!j.isNull()) {
+                    for (const auto& kv : j) {
+                        stopCond.parameterName = kv.key().c_str();
+                        // currently we do only support "capacityAh"
+                        if (stopCond.parameterName != ParameterName::capacityAh) {
+                            LOGE((StackString<128>() << F("program \"") << name << F("\": invalid program step ") << steps.size() << F(": invalid parameter name of stop condition")).c_str());
+                            Clear();
+                            return;
+                        }
+                        if (kv.value().is<double>()) {
+                            stopCond.kind = StopCondition::Condition_Absolute;
+                            stopCond.value = kv.value().as<double>();
+                        } else
+                        if (kv.value().is<int>()) {
+                            stopCond.kind = StopCondition::Condition_Absolute;
+                            stopCond.value = kv.value().as<int>();
+                        } else
+                        if (kv.value().is<const char*>()) {
+                            String value = kv.value().as<const char*>();
+                            stopCond.kind = StopCondition::Condition_Absolute;
+                            int pos = value.indexOf('%');
+                            if (0 <= pos) {
+                                value = value.substring(0, pos);
+                                stopCond.kind = StopCondition::Condition_Percent;
+                            }
+                            stopCond.value = value.toDouble();
                         }
-                        stopCond.value = value.toDouble();
                     }
                 }
-            }
 
-            AddStepCommand(cmd, stopCond);
+                AddStepCommand(cmd, stopCond);
+                JsonObject parameters = v["parameters"];
+                if (!parameters.isNull()) {
+                    steps.back().voltageV = parameters[ParameterName::voltageV].as<double>();
+                    steps.back().cutoffV = parameters[ParameterName::cutoffV].as<double>();
+                }
+            }
         }
     }
-    if (!Report("program", jsonStr)) {
-        Logger::LogD(String(F("program \"")) + name + F("\": report failed"));
+    if (!Report("program", jsonStr.c_str())) {
+        LOGD((StackString<128>() << F("program \"") << name << F("\": report failed")).c_str());
     } else {
         Report("state", "loaded");
-        Logger::LogD(String(F("program \"")) + name + F("\": has ") + steps.size() + F(" steps, controller is ") + controller.GetModel());
+        LOGD((StackString<128>() << F("program \"") << name << F("\": has ") << steps.size() << F(" steps, controller is ") << controller.GetModel()).c_str());
     }
 }
 
@@ -161,7 +196,7 @@ void Processor::AddStepWait(unsigned short seconds)
     Step step(Step::Step_Wait);
     step.seconds = seconds;
     steps.push_back(step);
-    Logger::LogD(F("added step: Wait"));
+    LOGD(F("added step: Wait"));
 }
 
 void Processor::AddStepCycle(unsigned short step_index, unsigned short count)
@@ -172,41 +207,50 @@ void Processor::AddStepCycle(unsigned short step_index, unsigned short count)
         step.count = count;
         step.current_cycle = 0;
         steps.push_back(step);
-        Logger::LogD(F("added step: Cycle"));
+        LOGD(F("added step: Cycle"));
     } else {
-        Logger::LogE(F("invalid step: Cycle"));
+        LOGE(F("invalid step: Cycle"));
     }
 }
 
-void Processor::AddStepCommand(Command command, StopCondition stop_cond)
+// the command is encoded here once, a step or cycle sends the frame as it is
+void Processor::AddStepCommand(const Command& command, StopCondition stop_cond)
 {
     Step step(Step::Step_Command);
-    step.command = command;
+    step.frame = frames.size();
     step.stop_condition = stop_cond;
+    frames.push_back(command.GetFrame());
     steps.push_back(step);
-    Logger::LogD(String(F("added step: ")) + String(command.GetCommandStr()) + F(" / ") + stop_cond.ToString());
+    LOGD(stop_cond.AddTo(StackString<128>() << F("added step: ") << command.GetCommandStr() << F(" / ")).c_str());
 }
 
-String Processor::StopCondition::ToString()
+const char* Processor::CommandStr(const Step& step) const
 {
-    String ret;
+    if (encoder == nullptr) {
+        return "?";
+    }
+    return encoder->CommandToString(frames[step.frame].GetCommand());
+}
 
+StringBuilder& Processor::StopCondition::AddTo(StringBuilder& s) const
+{
     switch (kind)
     {
         case Condition_Absolute:
-            ret += String(F("stop condition \"absolute\" (\"")) + parameterName + F("\" = ") + String(value, 3) + F(")");
+            s << F("stop condition \"absolute\" (\"") << parameterName << F("\" = ");
+            s.AddFixed(value, 3) << ')';
             break;
         case Condition_Percent:
-            ret += String(F("stop condition \"percent\" (\"")) + parameterName + F("\" = ") + String(value, 0) + F("%)");;
+            s << F("stop condition \"percent\" (\"") << parameterName << F("\" = ");
+            s.AddFixed(value, 0) << F("%)");
             break;
         case Condition_None:
-            ret += F("stop condition \"none\"");
+            s << F("stop condition \"none\"");
             break;
         default:
             break;
     }
-
-    return ret;
+    return s;
 }
 
 bool Processor::Run()
@@ -215,16 +259,17 @@ bool Processor::Run()
     Report("state", "running");
     Report("run", "on");
     running = true;
+    stepDeferred = false;   // a suspended program starts with Resume()
     StartStep(0);
     return true;
 }
 
 void Processor::Stop()
 {
-    timer.cancel();
+    timers.CancelAll(this);
     running = false;
     if ((currentStep < steps.size()) && steps[currentStep].command_active) {
-        command(EbcController::GetController().CreateStop());
+        IssueStop(EbcController::GetController());
         Report("state", "stopped");
     }
     Report("run", "off");
@@ -235,22 +280,50 @@ bool Processor::IsRunning()
     return running;
 }
 
-bool Processor::WaitTimeout(void *p)
+void Processor::Suspend()
+{
+    if (!suspended) {
+        LOGM((StackString<128>() << F("program \"") << name << F("\": suspended")).c_str());
+    }
+    suspended = true;
+}
+
+void Processor::Resume()
+{
+    if (!suspended) {
+        return;
+    }
+    suspended = false;
+    LOGM((StackString<128>() << F("program \"") << name << F("\": resumed")).c_str());
+    if (stepDeferred) {
+        stepDeferred = false;
+        if (running) {
+            PerformStep();
+        }
+    }
+}
+
+bool Processor::IsSuspended()
 {
-    return ((Processor*)p)->WaitTimeout();
+    return suspended;
 }
 
-bool Processor::WaitTimeout()
+void Processor::WaitTimeout(void *p)
+{
+    ((Processor*)p)->WaitTimeout();
+}
+
+void Processor::WaitTimeout()
 {
     StartStep(currentStep + 1);
-    return true;
 }
 
 void Processor::ReportStep(size_t index)
 {
     auto& step = steps[index];
 
-    StaticJsonDocument<192> doc;
+    StaticJsonDocument<320> doc;
+    StackString<16> duration;   // referenced by doc until it is serialized
 
     JsonObject root = doc.to<JsonObject>();
     root["step"] = index;
@@ -260,10 +333,11 @@ void Processor::ReportStep(size_t index)
             root["command"] = "Wait";
             if (0 < step.seconds) {
                 if (step.seconds % 60 != 0) {
-                    root["duration"] = String(step.seconds) + "s";
+                    duration << step.seconds << 's';
                 } else {
-                    root["duration"] = String(step.seconds/60) + "m";
+                    duration << step.seconds/60 << 'm';
                 }
+                root["duration"] = duration.c_str();
             }
             break;
         case Step::Step_Cycle:
@@ -273,8 +347,11 @@ void Processor::ReportStep(size_t index)
             root["count"] = step.count;
             break;
         case Step::Step_Command:
-            root["command"] = step.command.GetCommandStr();
+            root["command"] = CommandStr(step);
             root["capacityAh"] = step.capacity;
+            if (!CommandTracer::GetInstance().AddTrace(root.createNestedObject("latency"), frames[step.frame].GetCommand())) {
+                root.remove("latency");
+            }
             break;
     }
 
@@ -282,19 +359,28 @@ void Processor::ReportStep(size_t index)
     serializeJson(doc, output);
     results.push_back(output);
 
-    bool addComma = false;
-    output = "[";
+    // the joined array only lives until it is reported, so it is built in the frame arena
+    size_t total = 3;
     for (auto & r : results) {
-        if (addComma) {
-            output += ",";
-        } else {
-            addComma = true;
+        total += r.length() + 1;
+    }
+    FrameArena& arena = FrameArena::GetInstance();
+    char* buf = (char*)arena.Allocate(total);
+    if (buf == nullptr) {
+        return;
+    }
+    StringBuilder b(buf, total);
+    b << '[';
+    for (size_t i = 0; i < results.size(); ++i) {
+        if (0 < i) {
+            b << ',';
         }
-        output += r;
+        b << results[i];
     }
-    output += "]";
-    
-    Report("result", output);
+    b << ']';
+
+    Report("result", b.c_str());
+    arena.Free(buf);
 }
 
 void Processor::StartStep(size_t index)
@@ -302,24 +388,38 @@ void Processor::StartStep(size_t index)
     this->currentStep = index;
     if (this->running) {
         // start only the first step immediate, the later got a pause of 5s
-        timer.in((0 < index) ? 5000 : 0, Processor::RunNow, this);
+        Arm((0 < index) ? 5000 : 0, Processor::RunNow);
+    }
+}
+
+// without a timer the program would never continue, it is stopped instead
+void Processor::Arm(unsigned long ms, TimerWheel::Handler handler)
+{
+    if (timers.In(ms, handler, this) == TimerWheel::InvalidTimer) {
+        LOGE((StackString<128>() << F("program \"") << name << F("\": step ") << currentStep << F(": no timer left, program stopped")).c_str());
+        Stop();
+        Report("state", "stopped");
     }
 }
 
-bool Processor::RunNow(void *p)
+void Processor::RunNow(void *p)
 {
     ((Processor*)p)->PerformStep();
-    return true;
 }
 
 void Processor::PerformStep()
 {
+    if (suspended) {
+        // started again by Resume()
+        stepDeferred = true;
+        return;
+    }
     if (0 < currentStep) {
         ReportStep(currentStep - 1);
     }
     if (steps.size() <= currentStep) {
         // finished
-        Logger::LogM(String(F("program \"")) + name + F("\": end "));
+        DLOGM("program: end");
         Report("step", "");
         Report("run", "off");
         Report("state", "end");
@@ -329,42 +429,40 @@ void Processor::PerformStep()
         }
         return;
     }
-    Report("step", String(currentStep));
+    Report("step", (StackString<12>() << currentStep).c_str());
+    if (event != nullptr) {
+        event(Cpu_Step_Started);
+    }
     auto& step = steps[currentStep];
     switch (step.action) {
         case Step::Step_Wait:
-            {
-                String duration;
-                if (step.seconds % 60 != 0) {
-                    duration = String(step.seconds) + F(" seconds");
-                } else {
-                    duration = String(step.seconds/60) + F(" minutes");
-                }
-                Logger::LogM(String(F("program \"")) + name + F("\": perform step ") + currentStep + F(": Wait ") + duration);
+            if (step.seconds % 60 != 0) {
+                DLOGM("program: perform step %u: Wait %lu seconds", (unsigned)currentStep, (unsigned long)step.seconds);
+            } else {
+                DLOGM("program: perform step %u: Wait %lu minutes", (unsigned)currentStep, (unsigned long)step.seconds/60);
             }
-            timer.in(step.seconds * 1000, WaitTimeout, this);
+            Arm(step.seconds * 1000UL, WaitTimeout);
             break;
         case Step::Step_Cycle:
             if (step.count == step.current_cycle) {
                 // next step
                 step.current_cycle = 0;
-                Logger::LogM(String(F("program \"")) + name + F("\": perform step ") + currentStep + F(": Cycle elapsed"));
+                DLOGM("program: perform step %u: Cycle elapsed", (unsigned)currentStep);
                 StartStep(currentStep + 1);
             } else {
                 // cycle back
-                Logger::LogM(String(F("program \"")) + name + F("\": perform step ") + currentStep
-                    + F(": Cycle to step ") + step.step_index + F(" (") + (step.current_cycle+1) + F("/") + step.count + F(")"));
+                DLOGM("program: Cycle to step %u (%u/%u)", (unsigned)step.step_index, (unsigned)(step.current_cycle+1), (unsigned)step.count);
                 step.current_cycle++;
                 StartStep(step.step_index);
             }
             break;
         case Step::Step_Command:
-            Logger::LogM(String(F("program \"")) + name + F("\": perform step ") + currentStep + F(": Command ") + step.command.GetCommandStr() );
+            DLOGM("program: perform step %u: Command %s", (unsigned)currentStep, CommandStr(step));
             if (command != nullptr) {
-                bool success = command(step.command);
+                bool success = command(frames[step.frame]);
                 step.command_active = true;
                 if (!success) {
-                    Logger::LogE(String(F("program \"")) + name + F("\": step ") + currentStep + F(": failed to send command"));
+                    DLOGE("program: step %u: failed to send command", (unsigned)currentStep);
                     Stop();
                     return;
                 }
@@ -373,8 +471,24 @@ void Processor::PerformStep()
     }
 }
 
+int Processor::GetStep() const
+{
+    return running ? (int)currentStep : -1;
+}
+
+bool Processor::GetStepLimits(double& voltageV, double& cutoffV) const
+{
+    if (!running || (steps.size() <= currentStep) || !steps[currentStep].command_active) {
+        return false;
+    }
+    voltageV = steps[currentStep].voltageV;
+    cutoffV = steps[currentStep].cutoffV;
+    return true;
+}
+
 void Processor::InjectData(const EbcController& controller)
 {
+    PROFILE_SCOPE(Prof_Inject);
     if (steps.size() <= currentStep) {
         // finished
         return;
@@ -387,71 +501,65 @@ void Processor::InjectData(const EbcController& controller)
         return;
     }
 
-    Command_t cmd = step.command.GetCommand();
+    Command_t cmd = frames[step.frame].GetCommand();
     if (controller.IsActiveResponseForCommand(cmd)) 
     {
-        const std::vector<Parameter>& parameters = controller.GetResponseParameters();
-        for (auto & p : parameters) {
-            if (p.name == ParameterName::capacityAh) {
-                step.capacity = p.value;
-                break; // for
-            }
+        double capacity = 0.0;
+        if (controller.GetResponseValue(ParameterName::capacityAh, capacity)) {
+            step.capacity = capacity;
         }
     }
 
     // check additional stop condition here!
     bool shouldActionBeStopped = false;
-    if (step.stop_condition.kind != StopCondition::Condition_None)
+    double pvalue = 0.0;
+    if ((step.stop_condition.kind != StopCondition::Condition_None)
+        && controller.GetResponseValue(step.stop_condition.parameterName.c_str(), pvalue))
     {
-        const std::vector<Parameter>& parameters = controller.GetResponseParameters();
-        for (auto & p : parameters) {
-            auto pvalue = p.value;
-            if (p.name == step.stop_condition.parameterName) {
-                switch (step.stop_condition.kind)
-                {
-                case StopCondition::Condition_Absolute:
-                    if (step.stop_condition.value <= pvalue) {
-                        Logger::LogD(String(F("program \"")) + name + F("\": step ") + currentStep
-                         + F(": absolute stop condition hit: ") + String(step.stop_condition.value, 3) + F(" <= ") + String(pvalue, 3));
-                        shouldActionBeStopped = true;
-                    }
-                    break;
-                case StopCondition::Condition_Percent:
-                    {
-                        double capacity = 0.0;
-                        // find the value to compare
-                        for (int idx = currentStep-1; 0 <= idx; --idx) {
-                            auto& s = steps[idx];
-                            if (s.action == Step::Step_Command) {
-                                // Logger::LogD(F("program \"") + name + F("\": step ") + currentStep + F(": found capacity to compare in step ") + idx + F(": value = ") + s.capacity);
-                                capacity = s.capacity;
-                                break; // for;
-                            }
-                        }
-                        double percent_value = (capacity * step.stop_condition.value / 100.0);
-                        if (percent_value <= pvalue) {
-                            Logger::LogD(String(F("program \"")) + name + F("\": step ") + currentStep
-                            + F(": relative stop condition hit: (") + step.stop_condition.value + F("% of ") + String(capacity, 3) + F(" = ") + String(percent_value, 3) + F(") <= ") + String(pvalue, 3));
-                            shouldActionBeStopped = true;
-                        }
+        switch (step.stop_condition.kind)
+        {
+        case StopCondition::Condition_Absolute:
+            if (step.stop_condition.value <= pvalue) {
+                LOGD((StackString<128>() << F("program \"") << name << F("\": step ") << currentStep
+                 << F(": absolute stop condition hit: ")).AddFixed(step.stop_condition.value, 3).Add(F(" <= ")).AddFixed(pvalue, 3).c_str());
+                shouldActionBeStopped = true;
+            }
+            break;
+        case StopCondition::Condition_Percent:
+            {
+                double capacity = 0.0;
+                // find the value to compare
+                for (int idx = currentStep-1; 0 <= idx; --idx) {
+                    auto& s = steps[idx];
+                    if (s.action == Step::Step_Command) {
+                        // Logger::LogD(F("program \"") + name + F("\": step ") + currentStep + F(": found capacity to compare in step ") + idx + F(": value = ") + s.capacity);
+                        capacity = s.capacity;
+                        break; // for;
                     }
-                    break;
-                
-                default:
-                    break;
                 }
-                break; // for
+                double percent_value = (capacity * step.stop_condition.value / 100.0);
+                if (percent_value <= pvalue) {
+                    LOGD((StackString<128>() << F("program \"") << name << F("\": step ") << currentStep
+                    << F(": relative stop condition hit: (")).AddFixed(step.stop_condition.value, 2).Add(F("% of ")).AddFixed(capacity, 3)
+                    .Add(F(" = ")).AddFixed(percent_value, 3).Add(F(") <= ")).AddFixed(pvalue, 3).c_str());
+                    shouldActionBeStopped = true;
+                }
             }
+            break;
+        
+        default:
+            break;
         }
     }
 
     if (shouldActionBeStopped) {
         // stop!
-        command(controller.CreateStop());
+        IssueStop(controller);
         step.stop_issued = true;
     }
 
     if (controller.IsFinishedResponseForCommand(cmd)) {
+        CommandTracer::GetInstance().OnFinished(cmd, timers.Now(), false);
         step.command_active = false;
         if (event != nullptr) {
             event(Cpu_Command_Finished);
@@ -462,8 +570,9 @@ void Processor::InjectData(const EbcController& controller)
 
     if (controller.IsStoppedResponseForCommand(cmd)) {
         if (!step.stop_issued) {
-            Logger::LogD(String(F("program \"")) + name + F("\": step ") + currentStep + F(": missed finishd message for command ") + step.command.GetCommandStr());
+            LOGD((StackString<128>() << F("program \"") << name << F("\": step ") << currentStep << F(": missed finishd message for command ") << CommandStr(step)).c_str());
         }
+        CommandTracer::GetInstance().OnFinished(cmd, timers.Now(), true);
         step.command_active = false;
         if (event != nullptr) {
             event(Cpu_Command_Finished);
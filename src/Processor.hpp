@@ -3,24 +3,27 @@
 
 #include <Arduino.h>
 #include <ArduinoJson.h>
-#include <arduino-timer.h>
 
 #include <vector>
 #include "Command.hpp"
+#include "CommandFrame.hpp"
 #include "Response.hpp"
 #include "Parameter.hpp"
 #include "EbcController.hpp"
+#include "TimerWheel.hpp"
+#include "StringBuilder.hpp"
 
 
 class Processor
 {
     public:
 
-        enum CpuEvent { Cpu_Command_Finished, Cpu_Program_End };
+        enum CpuEvent { Cpu_Step_Started, Cpu_Command_Finished, Cpu_Program_End };
 
-        typedef bool (*CommandDelegate) (const Command& cmd);
-        typedef bool (*ReportDelegate) (const String& key, const String& value);
+        typedef bool (*CommandDelegate) (const CommandFrame& cmd);
+        typedef bool (*ReportDelegate) (const char* key, const char* value);
         typedef void (*EventDelegate) (CpuEvent e);
+        typedef void (*StopDelegate) ();
 
         struct StopCondition
         {
@@ -33,7 +36,7 @@ class Processor
             ConditionType kind;
             double        value;
 
-            String ToString();
+            StringBuilder& AddTo(StringBuilder& s) const;
         };
 
         struct Step
@@ -42,64 +45,80 @@ class Processor
 
             Step(Step_t c)
                 : action(c), seconds(0), step_index(0), count(0),
-                  current_cycle(0), command(), command_active(false), stop_issued(false), capacity(0.0) {}
+                  current_cycle(0), frame(0), command_active(false), stop_issued(false), capacity(0.0),
+                  voltageV(0.0), cutoffV(0.0) {}
 
             Step_t                  action;
             unsigned short          seconds;        // used by Step_Wait
             unsigned short          step_index;     // used by Step_Cycle
             unsigned short          count;          // used by Step_Cycle
             unsigned short          current_cycle;  // used by Step_Cycle
-            Command                 command;        // used by Step_Command
+            uint16_t                frame;          // used by Step_Command, index into the frame table
             bool                    command_active; // used by Step_Command
             StopCondition           stop_condition; // used by Step_Command
             bool                    stop_issued;    // used by Step_Command
             double                  capacity;       // on command step the accumulated data (Ah)
+            double                  voltageV;       // used by Step_Command, set-point (0 = none)
+            double                  cutoffV;        // used by Step_Command, set-point (0 = none)
             private:
             Step() {}
         };
 
-        Processor();
+        Processor(TimerWheel& timers);
 
         void SetCommmander(CommandDelegate c);
         void SetReportHandler(ReportDelegate r);
         void SetEventHandler(EventDelegate e);
+        void SetStopHandler(StopDelegate s);
 
         void Clear();
         void Load(const EbcController& controller, const String& json);
         void AddStepWait(unsigned short seconds);
         void AddStepCycle(unsigned short step, unsigned short count);
-        void AddStepCommand(Command command, StopCondition stop_cond = StopCondition());
+        void AddStepCommand(const Command& command, StopCondition stop_cond = StopCondition());
 
         bool Run();
         void Stop();
         bool IsRunning();
+        void Suspend();     // no further step is started until Resume()
+        void Resume();
+        bool IsSuspended();
 
         void InjectData(const EbcController& controller);
-        void Tick() {timer.tick();}
+        bool GetStepLimits(double& voltageV, double& cutoffV) const;   // of the active command step
+        int GetStep() const;    // -1 if not running
 
     private:
 
         CommandDelegate         command;
         ReportDelegate          report;
         EventDelegate           event;
+        StopDelegate            stop;
 
         String name;
         std::vector<Step> steps;
+        std::vector<CommandFrame> frames;   // the command steps, encoded once by Load()
+        const EbcController* encoder;       // the names of the commands in frames
         std::vector<String> results;
         bool running;
+        bool suspended;
+        bool stepDeferred;
         size_t currentStep;
-        Timer<> timer;
+        TimerWheel& timers;
 
-        static bool WaitTimeout(void *p);
-        bool WaitTimeout();
+        static void WaitTimeout(void *p);
+        void WaitTimeout();
 
-        static bool RunNow(void *p);
+        static void RunNow(void *p);
+        void Arm(unsigned long ms, TimerWheel::Handler handler);
 
+        const char* CommandStr(const Step& step) const;
         void ReportStep(size_t index);
         void StartStep(size_t index);
         void PerformStep();
 
-        bool Report(const String& key, const String& value);
+        bool Report(const char* key, const char* value);
+        void IssueStop(const EbcController& controller);
 };
 
 #endif // _PROCESSOR_HPP_
\ No newline at end of file
@@ -1,6 +1,5 @@
 #include <Arduino.h>
 #include <Homie.h>
-#include <arduino-timer.h>
 
 #ifdef ESP8266
 #include <SoftwareSerial.h>
@@ -11,9 +10,27 @@
 #include <queue>
 #include "Logger.hpp"
 #include "Command.hpp"
+#include "CommandQueue.hpp"
+#include "CommandFrame.hpp"
 #include "Response.hpp"
 #include "Processor.hpp"
 #include "EbcController.hpp"
+#include "FrameClock.hpp"
+#include "FastStop.hpp"
+#include "LinkMonitor.hpp"
+#include "TimerWheel.hpp"
+#include "PowerManager.hpp"
+#include "Profiler.hpp"
+#include "HealthMetrics.hpp"
+#include "CommandTracer.hpp"
+#include "PublishCache.hpp"
+#include "TelemetryPolicy.hpp"
+#include "TelemetryRate.hpp"
+#include "TelemetryRecord.hpp"
+#include "Outbox.hpp"
+#include "RawCapture.hpp"
+#include "StringBuilder.hpp"
+#include "FrameArena.hpp"
 #include "fw_version.h"
 
 
@@ -25,13 +42,78 @@ HardwareSerial ebcSerial = Serial2;
 
 
 
-static Command        nextCommand;
-static Command        activeCommand;
+static CommandQueue   commandQueue;
+static CommandFrame   activeCommand;
 static Response       response;
 static EbcController* controller = &EbcController::GetController();
 static ParameterStore store;
-static Processor      processor;
+static TimerWheel     timers;                 // owns all deadlines, see TimerWheel
+static Processor      processor(timers);
+static PowerManager   power;
+static HealthMetrics  health(response, timers);
+static PublishCache   publishCache;           // suppresses unchanged values of the controller and cpu nodes
+static Outbox         outbox;                 // results and telemetry that could not be published
+
+// the telemetry has its own policies (deadband, min/max interval), see TelemetryPolicy
+struct Telemetry
+{
+  const char*     property;
+  const char*     parameter;
+  TelemetryPolicy policy;
+};
+static Telemetry telemetry[] = {
+  {"voltage",  ParameterName::voltageV,   TelemetryPolicy(5, 0, 1000, 10000, 60000)},  // mV
+  {"current",  ParameterName::currentA,   TelemetryPolicy(5, 0, 1000, 10000, 60000)},  // mA
+  {"capacity", ParameterName::capacityAh, TelemetryPolicy(1, 0, 1000, 10000, 60000)},  // mAh
+};
+static TelemetryRate  telemetryRate(30000, 50);  // full rate 30s after an event or within 50mV of a step threshold
+static const char*    lastMode = nullptr;
+static const char*    sentMode = nullptr;       // the mode when the active command was sent
+static TelemetryRecord telemetryRecord;
+static unsigned long  lastRecordFrame = 0;
+static RawCapture     rawCapture;
+static char           captureTopic[TelemetryRecord::MAX_TOPIC_LEN];
+static bool           mqttReady = false;
+static bool           lastFrameValid = false; // the last frame was decoded into the store
+static unsigned long  lastDecodedFrame = 0;
+
+// boot timeline (ms since reset, 0 = not yet)
+struct BootTimeline
+{
+  unsigned long wifi;
+  unsigned long mqtt;
+  unsigned long firstFrame;
+  unsigned long firstPublish;
+};
+static BootTimeline   boot = {0, 0, 0, 0};
 static String         cpuProgramLoadPending;
+static FrameClock     frameClock;
+static FastStop       fastStop;
+static LinkMonitor    linkMonitor;
+static bool           resendPending = false;  // the active command waits for the next tx window again
+static bool           ackPending = false;     // a command was sent and waits for its acknowledge
+static uint8_t        ackRetries = 0;
+
+static TimerWheel::TimerId stateTimer = TimerWheel::InvalidTimer;    // timed transitions of the fsm
+static TimerWheel::TimerId ackTimer = TimerWheel::InvalidTimer;
+static TimerWheel::TimerId linkTimer = TimerWheel::InvalidTimer;
+static TimerWheel::TimerId linkStopTimer = TimerWheel::InvalidTimer;
+static TimerWheel::TimerId outboxTimer = TimerWheel::InvalidTimer;
+
+static const uint8_t  MAX_COMMAND_RETRIES = 3;
+static const unsigned long LINK_SAFE_STOP_MS = 60000; // a running program is stopped if the link stays lost
+static const unsigned long POWER_REPORT_MS = 60000;
+static const unsigned long CAPTURE_FLUSH_MS = 10000; // an incomplete batch of raw frames is published anyway
+static const unsigned long LOG_FLUSH_MS = 1000;      // deferred log messages are published in batches
+static const unsigned long PROBE_INTERVAL_MS = 3000; // a silent charger is asked to connect while mqtt comes up
+static const uint8_t       PROBE_ATTEMPTS = 5;
+static const unsigned long OUTBOX_FLUSH_MS = 250;    // the outbox is published in bursts, live messages go in between
+static const size_t OUTBOX_BURST_RECORDS = 8;
+static const size_t OUTBOX_BURST_BYTES = 2048;
+static const char* OUTBOX_FILE = "/outbox.bin";
+#ifdef EBC_PROFILER
+static const unsigned long PROFILE_REPORT_MS = 60000;
+#endif
 
 #ifdef ESP8266
 HomieNode esp("esp", "ESP8266", "system");
@@ -41,45 +123,88 @@ HomieNode esp("esp", "ESP32", "system");
 HomieNode raw("raw", "RAW data", "raw");
 HomieNode ebc("controller", "Controller", "controller");
 HomieNode cpu("cpu", "Processor", "cpu");
+HomieNode metrics("metrics", "Metrics", "metrics");
+#ifdef EBC_PROFILER
+HomieNode stats("stats", "Statistics", "stats");
+#endif
+
+// a debug stream is produced only while its gate is open, it closes after the ttl
+struct DebugGate {
+  HomieNode&          node;
+  void                (*apply)(bool open);
+  bool                open;
+  unsigned long       until;
+  TimerWheel::TimerId timer;
+  long                pendingTtl;     // set by the mqtt callback, applied by the loop, -1 = none
+};
+static void setDebugLog(bool open) { Logger::GetInstance().SetDebug(open); }
+static DebugGate rawGate = {raw, nullptr, false, 0, TimerWheel::InvalidTimer, -1};       // raw/in, raw/out
+static DebugGate espGate = {esp, setDebugLog, false, 0, TimerWheel::InvalidTimer, -1};   // esp/debug
+static String    telemetryPolicyPending;  // set by the mqtt callback, applied by the loop
+static const long MAX_GATE_TTL = 86400;
+
+HomieSetting<long> metricsInterval("metricsInterval", "publish interval of the metrics in seconds (0 = off)");
+HomieSetting<long> publishKeepAlive("publishKeepAlive", "seconds after an unchanged value is published again (0 = never)");
+HomieSetting<long> frameRefresh("frameRefresh", "max seconds a repeated frame is not decoded again (0 = decode every frame)");
+HomieSetting<long> telemetryInterval("telemetryInterval", "publish interval of the compact telemetry record in seconds (0 = off)");
+HomieSetting<bool> propertyTopics("propertyTopics", "publish raw/in, mode, response, voltage, current and capacity as single properties");
+HomieSetting<long> logLevel("logLevel", "lowest severity that is logged: 0 = debug, 1 = message, 2 = error, 3 = none");
+HomieSetting<long> captureBatch("captureBatch", "raw frames per message of raw/capture (0 = off)");
+HomieSetting<bool> captureHex("captureHex", "raw/capture as hex lines instead of binary");
+HomieSetting<bool> binaryPayloads("binaryPayloads", "publish response, result and program also as MessagePack on .../bin");
+HomieSetting<long> outboxSpill("outboxSpill", "max kB of unpublished results and telemetry kept on flash while mqtt is down (0 = ram only)");
+HomieSetting<const char*> telemetryPolicy("telemetryPolicy", "json object of the deadband and interval policies of voltage, current and capacity");
 
 // Home callback functions
 bool connectionHandler(const HomieRange& range, const String& value);
 bool cpuProgramLoadHandler(const HomieRange& range, const String& value);
 bool cpuProgramRunHandler(const HomieRange& range, const String& value);
+bool telemetryPolicyHandler(const HomieRange& range, const String& value);
+bool rawEnableHandler(const HomieRange& range, const String& value);
+bool espEnableHandler(const HomieRange& range, const String& value);
 
 // FSM callback functions
 void on_enter_disconnected();
+void on_enter_connecting();
 void on_enter_connected();
+void on_enter_disconnecting();
 void on_inject_data();
 void on_data();
 void on_load();
+void on_first_data();
 
 // FSM events
 enum Event {
   Evt_init,
+  Evt_init_connected,
   Evt_connect,
   Evt_disconnect,
   Evt_command,
   Evt_command_finished,
   Evt_data,
   Evt_response,
+  Evt_ack,
+  Evt_tx_window,
+  Evt_timeout,
+  Evt_state_timeout,
   Evt_load,
   Evt_run,
   Evt_stop,
-  Evt_end
+  Evt_end,
+  Evt_settings    // not for the fsm, applies the settings changed by mqtt in the loop
 };
 
 // FSM states
 //                                 State(void (*on_enter)(),      void (*on_state)(),  void (*on_exit)());
 State SX_null                           (NULL,                    NULL,                NULL);
 State S0_disconnected                   (&on_enter_disconnected,  NULL,                NULL);
-State S1_connecting                     (NULL,                    NULL,                NULL);
-State S2_connecting_load                (NULL,                    NULL,                &on_load);
+State S1_connecting                     (&on_enter_connecting,    NULL,                NULL);
+State S2_connecting_load                (&on_enter_connecting,    NULL,                &on_load);
 State S3_connected                      (&on_enter_connected,     NULL,                NULL);
 State S4_command_queued                 (NULL,                    NULL,                NULL);
 State S5_command_issued                 (&on_data,                NULL,                NULL);
 State S6_disconnect_queued              (NULL,                    NULL,                NULL);
-State S7_disconnecting                  (NULL,                    NULL,                NULL);
+State S7_disconnecting                  (&on_enter_disconnecting, NULL,                NULL);
 
 State S10_running                       (NULL,                    NULL,                NULL);  // program is running inactive (Wait)
 State S11_running_command_queued        (NULL,                    NULL,                NULL);
@@ -98,9 +223,14 @@ void advertise()
   esp.advertise("debug").setDatatype("string");
   esp.advertise("message").setDatatype("string");
   esp.advertise("error").setDatatype("string");
+  esp.advertise("power").setDatatype("string").setFormat("text/json");
+  esp.advertise("boot").setDatatype("string").setFormat("text/json");
+  esp.advertise("enable").setName("Debug enable").setDatatype("integer").setUnit("s").settable(espEnableHandler);
 
   raw.advertise("in").setName("RawIn").setDatatype("string");
   raw.advertise("out").setName("RawOut").setDatatype("string");
+  raw.advertise("capture").setName("RawCapture").setDatatype("string");
+  raw.advertise("enable").setName("RawEnable").setDatatype("integer").setUnit("s").settable(rawEnableHandler);
 
   ebc.advertise("connection").setName("Connection").setDatatype("enum").setUnit("on,off").settable(connectionHandler);
   ebc.advertise("model").setName("Model").setDatatype("string");
@@ -109,12 +239,27 @@ void advertise()
   ebc.advertise("voltage").setName("Voltage").setDatatype("float").setUnit("V");
   ebc.advertise("current").setName("Current").setDatatype("float").setUnit("A");
   ebc.advertise("capacity").setName("Capacity").setDatatype("float").setUnit("Ah");
+  ebc.advertise("link").setName("Link").setDatatype("enum").setUnit("idle,up,lost");
+  ebc.advertise("linkstats").setName("Link statistics").setDatatype("string").setFormat("text/json");
+  ebc.advertise("stoplatency").setName("Stop latency").setDatatype("integer").setUnit("ms");
+  ebc.advertise("stopstats").setName("Stop statistics").setDatatype("string").setFormat("text/json");
+  ebc.advertise("telemetry").setName("Telemetry").setDatatype("string").setFormat("text/json");
+  ebc.advertise("policy").setName("Telemetry policy").setDatatype("string").setFormat("text/json").settable(telemetryPolicyHandler);
 
   cpu.advertise("program").setDatatype("string").setFormat("text/json").settable(cpuProgramLoadHandler);
   cpu.advertise("run").setDatatype("enum").setUnit("on,off").settable(cpuProgramRunHandler);
   cpu.advertise("state").setDatatype("enum").setUnit("idle,loaded,running,stopped,end");
   cpu.advertise("step").setDatatype("integer");
   cpu.advertise("result").setDatatype("string").setFormat("text/json");
+
+  metrics.advertise("health").setName("Health").setDatatype("string").setFormat("text/json");
+  metrics.advertise("telemetry").setName("Suppressed telemetry").setDatatype("string").setFormat("text/json");
+  metrics.advertise("commands").setName("Command latency").setDatatype("string").setFormat("text/json");
+  metrics.advertise("outbox").setName("Offline buffer").setDatatype("string").setFormat("text/json");
+
+#ifdef EBC_PROFILER
+  stats.advertise("profile").setName("Profile").setDatatype("string").setFormat("text/json");
+#endif
 }
 
 
@@ -136,29 +281,252 @@ void Logging(Logger::LogSeverity l, const char* msg)
   }
 }
 
+void onGateExpired(void *arg) {
+  DebugGate* gate = (DebugGate*)arg;
+  gate->timer = TimerWheel::InvalidTimer;
+  gate->open = false;
+  if (gate->apply != nullptr) {
+    gate->apply(false);
+  }
+  if (mqttReady) {
+    gate->node.setProperty("enable").send("0");
+  }
+}
+
+// the value is the ttl in seconds, 0 closes the gate.
+// called by the mqtt client (on ESP32 by another task), the timers are changed by the loop
+bool setGate(DebugGate& gate, const String& value)
+{
+  long ttl = value.toInt();
+  if ((ttl < 0) || (MAX_GATE_TTL < ttl) || ((ttl == 0) && (value != "0"))) {
+    return false;
+  }
+  gate.pendingTtl = ttl;
+  eventQueue.push(Evt_settings);
+  return true;
+}
+
+void applyGate(DebugGate& gate)
+{
+  long ttl = gate.pendingTtl;
+  if (ttl < 0) {
+    return;
+  }
+  gate.pendingTtl = -1;
+  timers.Cancel(gate.timer);
+  gate.timer = (0 < ttl) ? timers.In(ttl * 1000UL, onGateExpired, &gate) : TimerWheel::InvalidTimer;
+  gate.open = (0 < ttl);
+  gate.until = timers.Now() + ttl * 1000UL;
+  if (gate.apply != nullptr) {
+    gate.apply(gate.open);
+  }
+  gate.node.setProperty("enable").send((StackString<12>() << ttl).c_str());
+}
+
+// the remaining ttl in seconds
+void publishGate(const DebugGate& gate)
+{
+  StackString<12> ttl;
+  ttl << (gate.open ? (gate.until - timers.Now() + 999) / 1000 : 0UL);
+  gate.node.setProperty("enable").send(ttl.c_str());
+}
+
+bool rawEnableHandler(const HomieRange& range, const String& value)
+{
+  return setGate(rawGate, value);
+}
+
+bool espEnableHandler(const HomieRange& range, const String& value)
+{
+  return setGate(espGate, value);
+}
+
+// a charger talks already, its frames were read while wifi and mqtt came up
+bool chargerPresent() {
+  return lastFrameValid && frameClock.HasFrame()
+    && ((timers.Now() - frameClock.GetLastFrame()) <= linkMonitor.GetTimeout(frameClock));
+}
+
+void startOutboxFlush();
+
 void onHomieEvent(const HomieEvent& event) {
   switch(event.type) {
+    case HomieEventType::WIFI_CONNECTED:
+      if (boot.wifi == 0) {
+        boot.wifi = timers.Now();
+      }
+      break;
     case HomieEventType::MQTT_READY:
-        eventQueue.push(Evt_init);
+      mqttReady = true;
+      publishCache.Clear(); // the broker may have lost the retained values
+      if (boot.mqtt == 0) {
+        boot.mqtt = timers.Now();
+      }
+      eventQueue.push(chargerPresent() ? Evt_init_connected : Evt_init);
+      startOutboxFlush();
+      break;
+    case HomieEventType::MQTT_DISCONNECTED:
+      mqttReady = false;
       break;
   }
 }
 
-bool send(const Command& cmd)
+bool send(const CommandFrame& frame)
 {
-  if (cmd.Send(ebcSerial)) {
+  if (frame.Send(ebcSerial)) {
     // ebcSerial.flush();
-    raw.setProperty("out").send(cmd.ToHexString());
+    rawCapture.Add(timers.Now(), RawCapture::Dir_Out, frame.bytes, CommandFrame::LENGTH);
+    if (mqttReady && rawGate.open) {
+      char hex[2 * CommandFrame::LENGTH + 1];
+      frame.WriteHex(hex, sizeof(hex));
+      raw.setProperty("out").send(hex);
+    }
     return true;
   }
   return false;
 }
 
-void ebcSendProperty(const char* name, const String& value)
+bool send(const Command& cmd)
+{
+  return send(cmd.GetFrame());
+}
+
+// the single properties of the frames may be replaced by the telemetry record
+bool propertyTopicsEnabled()
+{
+  return propertyTopics.get();
+}
+
+// the MessagePack variant of a property, published on <property>/bin
+void sendBinary(const char* node, const char* name, const uint8_t* data, size_t len)
+{
+  char topic[TelemetryRecord::MAX_TOPIC_LEN];
+  int n = snprintf(topic, sizeof(topic), "%s%s/%s/%s/bin", Homie.getConfiguration().mqtt.baseTopic,
+    Homie.getConfiguration().deviceId, node, name);
+  if ((n < 0) || (sizeof(topic) <= (size_t)n)) {
+    return;
+  }
+  PROFILE_SCOPE(Prof_Publish);
+  uint16_t packetId = Homie.getMqttClient().publish(topic, 1, true, (const char*)data, len);
+  health.OnPublish(packetId != 0);
+  if (packetId == 0) {
+    DLOGE("Cannot send binary property %s/%s", node, name);
+  }
+}
+
+// the json value is converted, the MessagePack output has the same structure
+void sendBinaryJson(const char* node, const char* name, const char* json)
+{
+  FrameJsonDocument doc(strlen(json) * 2 + 128);
+  if (deserializeJson(doc, json) != DeserializationError::Ok) {
+    DLOGE("Cannot convert property %s/%s", node, name);
+    return;
+  }
+  size_t len = measureMsgPack(doc);
+  uint8_t* data = (uint8_t*)FrameArena::GetInstance().Allocate(len);
+  if (data == nullptr) {
+    return;
+  }
+  serializeMsgPack(doc, data, len);
+  sendBinary(node, name, data, len);
+  FrameArena::GetInstance().Free(data);
+}
+
+// topic is "<node>/<property>", false if it has to be tried again
+bool outboxPublish(const char* topic, const char* value, bool retained)
+{
+  char full[TelemetryRecord::MAX_TOPIC_LEN];
+  int n = snprintf(full, sizeof(full), "%s%s/%s", Homie.getConfiguration().mqtt.baseTopic,
+    Homie.getConfiguration().deviceId, topic);
+  if ((n < 0) || (sizeof(full) <= (size_t)n)) {
+    return true; // never fits, skip it
+  }
+  PROFILE_SCOPE(Prof_Publish);
+  uint16_t packetId = Homie.getMqttClient().publish(full, 1, retained, value);
+  health.OnPublish(packetId != 0);
+  return packetId != 0;
+}
+
+void onOutboxFlush(void *) {
+  outboxTimer = TimerWheel::InvalidTimer;
+  if (!mqttReady) {
+    return; // started again by MQTT_READY
+  }
+  outbox.Flush(outboxPublish, OUTBOX_BURST_RECORDS, OUTBOX_BURST_BYTES);
+  if (!outbox.IsEmpty()) {
+    outboxTimer = timers.In(OUTBOX_FLUSH_MS, onOutboxFlush);
+  }
+}
+
+void startOutboxFlush() {
+  if (!outbox.IsEmpty() && !timers.IsPending(outboxTimer)) {
+    outboxTimer = timers.In(OUTBOX_FLUSH_MS, onOutboxFlush);
+  }
+}
+
+// a value that cannot be published now is kept and published later
+bool outboxAdd(Outbox::Kind kind, const char* node, const char* name, const char* value)
 {
+  if (!outbox.Add(kind, node, name, value, timers.Now())) {
+    return false;
+  }
+  if (mqttReady) {
+    startOutboxFlush();
+  }
+  return true;
+}
+
+// an event (cached = false) is published even if the value didn't change,
+// returns false if nothing was published
+bool ebcSendProperty(const char* name, const char* value, bool cached = true)
+{
+  if (!mqttReady) {
+    if (!cached) {
+      outboxAdd(Outbox::Kind_Telemetry, "controller", name, value);
+    }
+    return false; // published by on_initialize...() as soon as mqtt is ready
+  }
+  if (cached && !publishCache.Check("controller", name, value, timers.Now())) {
+    health.OnPublishSuppressed();
+    return false;
+  }
+  PROFILE_SCOPE(Prof_Publish);
   uint16_t packetId = ebc.setProperty(name).send(value);
+  health.OnPublish(packetId != 0);
   if (packetId == 0) {
-    Logger::LogE(String(F("ebc: Cannot send property ")) + String(name) + F(" (") + value + F(")"));
+    publishCache.Forget("controller", name);
+    LOGE((StackString<128>() << F("ebc: Cannot send property ") << name << F(" (") << value << ')').c_str());
+    if (!cached) {
+      outboxAdd(Outbox::Kind_Telemetry, "controller", name, value);
+    }
+  }
+  return packetId != 0;
+}
+
+bool ebcSendProperty(const char* name, const String& value, bool cached = true)
+{
+  return ebcSendProperty(name, value.c_str(), cached);
+}
+
+// the response is written into a buffer, a String is only created if it has changed
+void ebcSendResponse()
+{
+  char json[256];
+  if (0 < controller->WriteResponseJson(json, sizeof(json))) {
+    if (ebcSendProperty("response", json) && binaryPayloads.get()) {
+      uint8_t data[160];
+      size_t len = controller->WriteResponseMsgPack(data, sizeof(data));
+      if (0 < len) {
+        sendBinary("controller", "response", data, len);
+      } else {
+        sendBinaryJson("controller", "response", json);
+      }
+    }
+  } else {
+    String response = controller->GetResponseJson();
+    if (ebcSendProperty("response", response) && binaryPayloads.get()) {
+      sendBinaryJson("controller", "response", response.c_str());
+    }
   }
 }
 
@@ -177,35 +545,121 @@ bool connectionHandler(const HomieRange& range, const String& value)
   return true;
 }
 
-bool cpuCommandHandler(const Command& cmd)
+CommandQueue::Priority commandPriority(const CommandFrame& cmd)
+{
+  if (controller->IsStopCommand(cmd.GetCommand())) {
+    return CommandQueue::Priority_Stop;
+  }
+  // the same command again while it is running only changes its set-points
+  if ((cmd.GetCommand() == activeCommand.GetCommand()) && controller->ModeIsActive()) {
+    return CommandQueue::Priority_SetPoint;
+  }
+  return CommandQueue::Priority_Start;
+}
+
+// the next queued command is issued after the active one is acknowledged
+void dispatchNextCommand()
+{
+  if (!commandQueue.IsEmpty()) {
+    eventQueue.push(Evt_command);
+  }
+}
+
+bool cpuCommandHandler(const CommandFrame& cmd)
 {
   if (cmd.GetCommand() == Command::InvalidCommand) {
-    Logger::LogE("command is invalid");
+    LOGE("command is invalid");
     return false;
   }
-  nextCommand = cmd;
+  if (!commandQueue.Push(cmd, commandPriority(cmd))) {
+    return false;
+  }
+  CommandTracer::GetInstance().OnQueued(cmd.GetCommand(), timers.Now());
   eventQueue.push(Evt_command);
   return true;
 }
 
-bool cpuReportHandler (const String& key, const String& value)
+bool cpuReportHandler (const char* key, const char* value)
 {
-  uint16_t packetId = cpu.setProperty(key).send(value);
+  if (!publishCache.Check("cpu", key, value, timers.Now())) {
+    health.OnPublishSuppressed();
+    return true;
+  }
+  // the results keep their order: behind the ones still in the outbox
+  uint16_t packetId = 0;
+  if (mqttReady && outbox.IsEmpty()) {
+    packetId = cpu.setProperty(key).send(value);
+    health.OnPublish(packetId != 0);
+  }
   if (packetId == 0) {
-    Logger::LogE(String(F("cpu: Cannot send property key: ")) + key);
-    Logger::LogE(String(F("cpu: Cannot send property value: ")) + value);
+    if (outboxAdd(Outbox::Kind_Result, "cpu", key, value)) {
+      return true;  // published by onOutboxFlush()
+    }
+    publishCache.Forget("cpu", key);
+    DLOGE("cpu: Cannot send property key: %s", key);
+    LOGE((StackString<128>() << F("cpu: Cannot send property value: ") << value).c_str());
     return false;
   }
+  if (binaryPayloads.get() && ((strcmp(key, "result") == 0) || (strcmp(key, "program") == 0))) {
+    sendBinaryJson("cpu", key, value);
+  }
   return true;
 }
 
+// a timed transition of the fsm: the timer is armed on entering a state and
+// replaced by the next state that has a timer itself
+void onStateTimeout(void *) {
+  stateTimer = TimerWheel::InvalidTimer;
+  eventQueue.push(Evt_state_timeout);
+}
+
+void armStateTimer(unsigned long ms) {
+  timers.Cancel(stateTimer);
+  stateTimer = (0 < ms) ? timers.In(ms, onStateTimeout) : TimerWheel::InvalidTimer;
+}
+
+void onAckTimeout(void *);
+void armLinkTimer();
+void armLinkSafeStop();
+
+void armAck() {
+  ackPending = true;
+  timers.Cancel(ackTimer);
+  ackTimer = timers.In(frameClock.GetAckTimeout(), onAckTimeout);
+}
+
+void clearAck() {
+  ackPending = false;
+  timers.Cancel(ackTimer);
+  ackTimer = TimerWheel::InvalidTimer;
+}
+
+// safety stop: bypasses the event queue, the fsm and the command queue
+void cpuStopHandler()
+{
+  fastStop.Arm(timers.Now());
+  // nothing queued or in flight may start the charger again after the stop
+  commandQueue.Clear();
+  resendPending = false;
+  if (ackPending) {
+    clearAck();
+    ackRetries = 0;
+    eventQueue.push(Evt_ack);
+  }
+}
+
 void cpuEventHandler(Processor::CpuEvent e)
 {
   switch (e) {
+    case Processor::CpuEvent::Cpu_Step_Started:
+      telemetryRate.OnEvent(timers.Now());
+      break;
     case Processor::CpuEvent::Cpu_Command_Finished:
+      telemetryRate.OnEvent(timers.Now());
       eventQueue.push(Evt_command_finished);
       break;
     case Processor::CpuEvent::Cpu_Program_End:
+      telemetryRate.OnEvent(timers.Now());
       eventQueue.push(Evt_end);
       break;
     default:
@@ -213,6 +667,72 @@ void cpuEventHandler(Processor::CpuEvent e)
   }
 }
 
+// e.g. {"voltage":{"deadband":5,"relative":0,"minMs":1000,"maxMs":60000},"current":{"deadband":10}}
+bool applyTelemetryPolicy(const char* json)
+{
+  StaticJsonDocument<512> doc;
+  DeserializationError error = deserializeJson(doc, json);
+  if (error) {
+    DLOGE("telemetry policy: %s", error.c_str());
+    return false;
+  }
+  bool ok = telemetryRate.SetFromJson(doc.as<JsonVariantConst>());
+  for (auto& t : telemetry) {
+    if (doc.containsKey(t.property) && !t.policy.SetFromJson(doc[t.property])) {
+      DLOGE("telemetry policy of %s is invalid", t.property);
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+void sendTelemetryPolicy()
+{
+  StaticJsonDocument<512> doc;
+  telemetryRate.AddToJson(doc.to<JsonObject>());
+  for (auto& t : telemetry) {
+    t.policy.AddToJson(doc.createNestedObject(t.property));
+  }
+  char json[384];
+  if (serializeJson(doc, json, sizeof(json)) < sizeof(json) - 1) {
+    ebcSendProperty("policy", json);
+  } else {
+    DLOGE("telemetry policy too long");
+  }
+}
+
+void writeTelemetrySuppressedJson(StringBuilder& json)
+{
+  json << '{';
+  for (auto& t : telemetry) {
+    if (&t != telemetry) {
+      json << ',';
+    }
+    json << '"' << t.property << F("\":") << t.policy.GetSuppressed();
+  }
+  json << '}';
+}
+
+// the policies are read by the loop, they are changed there as well
+bool telemetryPolicyHandler(const HomieRange& range, const String& value)
+{
+  telemetryPolicyPending = value;
+  eventQueue.push(Evt_settings);
+  return true;
+}
+
+// the changes of the mqtt callbacks
+void applySettings()
+{
+  applyGate(rawGate);
+  applyGate(espGate);
+  if (!telemetryPolicyPending.isEmpty()) {
+    applyTelemetryPolicy(telemetryPolicyPending.c_str());
+    telemetryPolicyPending.clear();
+    sendTelemetryPolicy();
+  }
+}
+
 bool cpuProgramLoadHandler(const HomieRange& range, const String& value)
 {
   cpuProgramLoadPending = value;
@@ -233,13 +753,30 @@ bool cpuProgramRunHandler(const HomieRange& range, const String& value)
   return true;
 }
 
-void on_initialize() {
+void addBootTime(StringBuilder& json, const __FlashStringHelper* name, unsigned long t) {
+  json << name;
+  if (0 < t) {
+    json << t;
+  } else {
+    json << F("null");
+  }
+}
+
+void publishBootTimeline() {
+  StackString<128> json;
+  addBootTime(json, F("{\"wifiMs\":"), boot.wifi);
+  addBootTime(json, F(",\"mqttMs\":"), boot.mqtt);
+  addBootTime(json, F(",\"firstFrameMs\":"), boot.firstFrame);
+  addBootTime(json, F(",\"firstPublishMs\":"), boot.firstPublish);
+  esp.setProperty("boot").send((json << '}').c_str());
+}
+
+void initialize() {
   esp.setProperty("debug").send("");
   esp.setProperty("message").send("");
   esp.setProperty("error").send("");
-
-  // on_enter_disconnected() <-- this will be executed by sure in the next step
-  ebcSendProperty("response", "{}"); // needs to be a json object!
+  publishGate(rawGate);
+  publishGate(espGate);
 
   cpuReportHandler("run", "off");
   cpuReportHandler("state", "idle");
@@ -247,19 +784,57 @@ void on_initialize() {
   cpuReportHandler("result", "[]");  // needs to be a json array!
 }
 
+void on_initialize() {
+  initialize();
+  sendTelemetryPolicy();
+  // on_enter_disconnected() <-- this will be executed by sure in the next step
+  ebcSendProperty("response", "{}"); // needs to be a json object!
+  publishBootTimeline();
+}
+
+// the charger was found while wifi and mqtt came up: publish its buffered data at once
+void on_initialize_connected() {
+  if (propertyTopicsEnabled()) {
+    ebcSendProperty("mode", controller->ModeAsString());
+    ebcSendResponse();
+  }
+  on_first_data();
+  initialize();
+  sendTelemetryPolicy();
+}
+
+void on_enter_connecting() {
+  armStateTimer(3000); // connect again
+}
+
+void on_enter_disconnecting() {
+  armStateTimer(3000); // the charger is silent, it is disconnected
+}
+
 void on_enter_disconnected() {
+  armStateTimer(0);
+  linkMonitor.SetExpected(false, timers.Now());
+  armLinkTimer();
   ebcSendProperty("connection", "off");
+  ebcSendProperty("link", linkMonitor.StateAsString());
   ebcSendProperty("mode", "");
   ebcSendProperty("model", "");
   ebcSendProperty("voltage", "0.0");
   ebcSendProperty("current", "0.0");
   ebcSendProperty("capacity", "0.0");
   Homie.setIdle(true);
+  power.SetIdle(true);
 }
 
 void on_enter_connected() {
+    armStateTimer(0);
+    if (linkMonitor.SetExpected(true, timers.Now())) {
+      armLinkTimer();
+      ebcSendProperty("link", linkMonitor.StateAsString());
+    }
     ebcSendProperty("connection", "on");
     Homie.setIdle(false);
+    power.SetIdle(false);
 }
 
 void on_connect() {
@@ -267,8 +842,13 @@ void on_connect() {
   send(EbcController::GetController().CreateConnect());
 }
 void on_disconnect() {
-  // send disconnect
+  // send disconnect, but not before a pending stop is confirmed
+  if (fastStop.IsArmed()) {
+    return;
+  }
   send(EbcController::GetController().CreateDisconnect());
+  linkMonitor.SetExpected(false, timers.Now()); // the charger stops talking now
+  armLinkTimer();
 }
 
 void on_inject_data() {
@@ -281,31 +861,88 @@ void on_inject_data() {
   }
 }
 
+// full rate around step and mode changes and near a voltage threshold of the active step
+bool telemetryFast() {
+  double voltageV = 0.0;
+  double cutoffV = 0.0;
+  if (controller->ModeIsActive() && processor.GetStepLimits(voltageV, cutoffV)) {
+    int32_t thresholds[] = { (int32_t)lround(voltageV * 1000.0), (int32_t)lround(cutoffV * 1000.0) };
+    telemetryRate.SetThresholds(thresholds, 2);
+  } else {
+    telemetryRate.ClearThresholds();
+  }
+  return telemetryRate.IsFast(timers.Now(), lround(store.GetValue(ParameterName::voltageV) * 1000.0));
+}
+
+void publishTelemetry(bool force) {
+  if (!propertyTopicsEnabled()) {
+    return;
+  }
+  bool fast = force || telemetryFast();
+  for (auto& t : telemetry) {
+    double value = store.GetValue(t.parameter);
+    int32_t milli = lround(value * 1000.0);
+    if (force) {
+      t.policy.Publish(milli, timers.Now());
+    } else
+    if (!t.policy.Check(milli, timers.Now(), fast)) {
+      continue;
+    }
+    StackString<16> s;
+    s.AddFixed(value, 3);
+    ebcSendProperty(t.property, s.c_str(), false); // the policy replaces the publish cache
+  }
+}
+
 void on_first_data() {
   ebcSendProperty("model", controller->GetModel());
-  ebcSendProperty("voltage", String(store.GetValue(ParameterName::voltageV), 3));
-  ebcSendProperty("current", String(store.GetValue(ParameterName::currentA), 3));
-  ebcSendProperty("capacity", String(store.GetValue(ParameterName::capacityAh), 3));
+  publishTelemetry(true);
+  if (boot.firstPublish == 0) {
+    boot.firstPublish = timers.Now();
+    publishBootTimeline();
+  }
 }
 
 void on_data() {
-  if (store.HasChanged(ParameterName::voltageV))
-    ebcSendProperty("voltage", String(store.GetValue(ParameterName::voltageV), 3));
-  if (store.HasChanged(ParameterName::currentA))
-    ebcSendProperty("current", String(store.GetValue(ParameterName::currentA), 3));
-  if (store.HasChanged(ParameterName::capacityAh))
-    ebcSendProperty("capacity", String(store.GetValue(ParameterName::capacityAh), 3));
+  publishTelemetry(false);
 }
 
 void on_command() {
-  // send command
-  send(nextCommand);
-  activeCommand = nextCommand;
-  Logger::LogD(String(F("command ")) + String(activeCommand.GetCommandStr()) + F(" started"));
+  // send command, a retry sends the active command again
+  if (!resendPending) {
+    if (!commandQueue.Pop(activeCommand)) {
+      eventQueue.push(Evt_ack); // nothing to send, leave the issued state
+      return;
+    }
+  }
+  send(activeCommand);
+  sentMode = lastMode;
+  CommandTracer::GetInstance().OnSent(activeCommand.GetCommand(), timers.Now());
+  resendPending = false;
+  armAck();
+  DLOGD("command %s started", controller->CommandToString(activeCommand.GetCommand()));
+}
+
+void on_ack() {
+  ackRetries = 0;
+  on_data();
+  dispatchNextCommand();
+}
+
+void on_inject_ack() {
+  ackRetries = 0;
+  on_inject_data();
+  dispatchNextCommand();
+}
+
+void on_retry() {
+  // send the same command again in the next tx window
+  ackRetries++;
+  resendPending = true;
 }
 
 void on_command_finished() {
-  Logger::LogD(String(F("command ")) + String(activeCommand.GetCommandStr()) + F(" finished"));
+  DLOGD("command %s finished", controller->CommandToString(activeCommand.GetCommand()));
 }
 
 void on_load() {
@@ -319,7 +956,11 @@ void on_load() {
 }
 
 void on_run() {
-  // run the program
+  // run the program, on a dead link the first step waits for it
+  if (linkMonitor.GetState() == LinkMonitor::Link_Lost) {
+    processor.Suspend();
+    armLinkSafeStop();
+  }
   processor.Run();
 }
 
@@ -329,18 +970,147 @@ void on_stop() {
 }
 
 
+void onLinkSafeStop(void *) {
+  linkStopTimer = TimerWheel::InvalidTimer;
+  if ((linkMonitor.GetState() == LinkMonitor::Link_Lost) && processor.IsRunning()) {
+    LOGE(F("charger link lost too long, program stopped"));
+    eventQueue.push(Evt_stop); // the stop is asserted as soon as the charger talks again
+  }
+}
+
+void armLinkSafeStop() {
+  timers.Cancel(linkStopTimer);
+  linkStopTimer = timers.In(LINK_SAFE_STOP_MS, onLinkSafeStop);
+}
+
+void onLinkLost() {
+  DLOGE("charger link lost, no frame for %lu ms", timers.Now() - frameClock.GetLastFrame());
+  ebcSendProperty("link", linkMonitor.StateAsString());
+  // do not start another step on a dead link
+  if (processor.IsRunning()) {
+    processor.Suspend();
+  }
+  armLinkSafeStop();
+}
+
+void onLinkResync() {
+  DLOGM("charger link resynced after %lu ms", linkMonitor.GetLastGap());
+  ebcSendProperty("link", linkMonitor.StateAsString());
+  StackString<96> stats;
+  linkMonitor.WriteStatsJson(stats);
+  ebcSendProperty("linkstats", stats.c_str());
+  timers.Cancel(linkStopTimer);
+  linkStopTimer = TimerWheel::InvalidTimer;
+  // a command issued into the dead link is send again
+  if (ackPending) {
+    clearAck();
+    resendPending = true;
+  }
+  processor.Resume();
+}
+
+// the outcome of every stop, confirmed or given up
+void sendStopStats() {
+  StackString<112> stats;
+  fastStop.WriteStatsJson(stats);
+  ebcSendProperty("stopstats", stats.c_str(), false);
+}
+
+void onLinkTimeout(void *) {
+  linkTimer = TimerWheel::InvalidTimer;
+  if (linkMonitor.Check(timers.Now(), frameClock)) {
+    onLinkLost();
+  }
+}
+
+// a missing frame is detected within about two frame periods after the last one
+void armLinkTimer() {
+  timers.Cancel(linkTimer);
+  linkTimer = TimerWheel::InvalidTimer;
+  if (linkMonitor.GetState() == LinkMonitor::Link_Up) {
+    linkTimer = timers.In(linkMonitor.GetTimeout(frameClock), onLinkTimeout);
+  }
+}
+
+// the finish mode only acknowledges a command that ran and finished since it was sent,
+// the same mode as at sending is left from the last run of the command
+bool isAck() {
+  Command_t cmd = activeCommand.GetCommand();
+  if (controller->IsAckResponseForCommand(cmd)) {
+    return true;
+  }
+  return controller->IsFinishedResponseForCommand(cmd)
+    && ((sentMode == nullptr) || (strcmp(sentMode, controller->ModeAsString()) != 0));
+}
+
+// a repeated frame changes no value as long as no command waits for its response
+bool canSkipFrame(unsigned long now) {
+  return response.IsRepeated()
+    && (0 < frameRefresh.get()) && ((now - lastDecodedFrame) < (unsigned long)frameRefresh.get() * 1000UL)
+    && !ackPending && !resendPending && commandQueue.IsEmpty() && !fastStop.IsArmed();
+}
+
 void readFromController() {
   // read input
   if (response.Read(ebcSerial)) {
-    raw.setProperty("in").send(response.ToHexString());
+    rawCapture.Add(timers.Now(), RawCapture::Dir_In, response);
+    bool resync = linkMonitor.OnFrame(timers.Now(), frameClock);
+    frameClock.OnFrame(timers.Now());
+    power.OnFrame(timers.Now());
+    armLinkTimer();
+    if (!resync && canSkipFrame(timers.Now())) {
+      health.OnFrameSkipped(); // not decoded and published again
+      // the fsm still sees the frame, some transitions wait for any response
+      if (lastFrameValid) {
+        eventQueue.push(Evt_response);
+      } else
+      if (controller->IsValidData()) {
+        eventQueue.push(Evt_data);
+      }
+      return;
+    }
+    lastDecodedFrame = timers.Now();
+
+    if (mqttReady && rawGate.open && propertyTopicsEnabled()) {
+      char hex[2 * 32 + 1];
+      if (0 < response.WriteHex(hex, sizeof(hex))) {
+        raw.setProperty("in").send(hex);
+      }
+    }
     controller = &EbcController::GetController(response);
+    if (boot.firstFrame == 0) {
+      boot.firstFrame = timers.Now();
+    }
+    if (resync) {
+      onLinkResync();
+    }
 
-    if (controller->IsValidResponseForCommand(activeCommand.GetCommand())) {
+    if (fastStop.IsArmed() && (controller->ModeIsStopped() || controller->ModeIsFinished())) {
+      fastStop.OnStopped(timers.Now());
+      DLOGD("stop confirmed after %lu ms (%u stop frames send)", fastStop.GetLastLatency(), fastStop.GetSends());
+      ebcSendProperty("stoplatency", (StackString<12>() << fastStop.GetLastLatency()).c_str(), false);
+      sendStopStats();
+    }
+
+    if ((lastMode == nullptr) || (strcmp(lastMode, controller->ModeAsString()) != 0)) {
+      lastMode = controller->ModeAsString();
+      telemetryRate.OnEvent(timers.Now());
+    }
+
+    lastFrameValid = controller->IsValidResponseForCommand(activeCommand.GetCommand());
+    if (lastFrameValid) {
       store.Push(controller->GetResponseParameters());
-      ebcSendProperty("mode", controller->ModeAsString());
-      ebcSendProperty("response", controller->GetResponseJson());
-      //eventQueue.push(Evt_data);
-      eventQueue.push(Evt_response);
+      if (propertyTopicsEnabled()) {
+        ebcSendProperty("mode", controller->ModeAsString());
+        ebcSendResponse();
+      }
+      if (ackPending && isAck()) {
+        CommandTracer::GetInstance().OnAcked(activeCommand.GetCommand(), timers.Now());
+        clearAck();
+        eventQueue.push(Evt_ack);
+      } else {
+        eventQueue.push(Evt_response);
+      }
     } else
     if (controller->IsValidData()) {
       eventQueue.push(Evt_data);
@@ -349,29 +1119,73 @@ void readFromController() {
   }
 }
 
+// the stop frame is written in the gap of the frame just read and re-asserted
+// in every following gap until a stopped mode is seen or the stop is given up.
+void assertStop() {
+  if (fastStop.IsExpired(timers.Now(), frameClock)) {
+    fastStop.GiveUp(timers.Now());
+    DLOGE("stop not confirmed after %lu ms (%u stop frames send), given up", fastStop.GetLastLatency(), fastStop.GetSends());
+    sendStopStats();
+    return;
+  }
+  if (fastStop.ShouldSend(timers.Now(), frameClock)) {
+    send(controller->CreateStop());
+    fastStop.OnSent(frameClock);
+  }
+}
+
+// an issued command is retried if its acknowledge is not seen in time.
+void onAckTimeout(void *) {
+  ackTimer = TimerWheel::InvalidTimer;
+  if (!ackPending || (linkMonitor.GetState() == LinkMonitor::Link_Lost)) {
+    return; // a dead link resends on resync
+  }
+  ackPending = false;
+  if (ackRetries < MAX_COMMAND_RETRIES) {
+    DLOGD("command %s not acknowledged, retry", controller->CommandToString(activeCommand.GetCommand()));
+    eventQueue.push(Evt_timeout);
+  } else {
+    DLOGE("command %s not acknowledged", controller->CommandToString(activeCommand.GetCommand()));
+    ackRetries = 0;
+    eventQueue.push(Evt_ack);
+  }
+}
+
+// a queued command is send in the first safe gap after a received frame
+void scheduleController() {
+  bool txPending = resendPending || !commandQueue.IsEmpty();
+  if (txPending && !ackPending && !fastStop.IsArmed() && frameClock.IsTxWindowOpen(timers.Now())) {
+    eventQueue.push(Evt_tx_window);
+  }
+}
+
 void setFsm() {
 // note:
   // commands are not send immediate to the ebc charger.
   // they are queued and send directly after the next data pdu from the charger to avoid
   // collisions between send and receive on the UART interface. the charger seems to NOT support
   // full duplex communication.
+  // the frame clock measures the cadence of the charger: a queued command is send in the
+  // first safe gap after a frame (Evt_tx_window), an issued command is acknowledged by the
+  // first matching response (Evt_ack) and retried after about two frame periods (Evt_timeout).
+  // a safety stop does not use the fsm at all, see assertStop().
+  // timed transitions are driven by the timer wheel (Evt_state_timeout), see armStateTimer().
 
   // FSM on normal operation
   fsm.add_transition(&SX_null, &S0_disconnected, Evt_init, &on_initialize);
-  fsm.add_timed_transition(&SX_null, &S0_disconnected, 5000, &on_initialize); // if Evt_init doesn't fire
+  fsm.add_transition(&SX_null, &S3_connected, Evt_init_connected, &on_initialize_connected);
 
   fsm.add_transition(&S0_disconnected, &S3_connected, Evt_data, NULL);
   fsm.add_transition(&S0_disconnected, &S3_connected, Evt_response, &on_first_data);
   fsm.add_transition(&S0_disconnected, &S1_connecting, Evt_connect, &on_connect);
-  fsm.add_timed_transition(&S1_connecting, &S1_connecting, 3000, &on_connect);
+  fsm.add_transition(&S1_connecting, &S1_connecting, Evt_state_timeout, &on_connect);
   fsm.add_transition(&S1_connecting, &S3_connected, Evt_response, &on_first_data);
   fsm.add_transition(&S1_connecting, &S0_disconnected, Evt_disconnect, &on_disconnect);
   
   fsm.add_transition(&S3_connected, &S4_command_queued, Evt_command, NULL);
-  fsm.add_transition(&S4_command_queued, &S5_command_issued, Evt_data, &on_command);
-  fsm.add_transition(&S4_command_queued, &S5_command_issued, Evt_response, &on_command);
-  fsm.add_timed_transition(&S5_command_issued, &S4_command_queued, 3000, &on_command);
-  fsm.add_transition(&S5_command_issued, &S3_connected, Evt_response, &on_data);
+  fsm.add_transition(&S4_command_queued, &S5_command_issued, Evt_tx_window, &on_command);
+  fsm.add_transition(&S5_command_issued, &S4_command_queued, Evt_timeout, &on_retry);
+  fsm.add_transition(&S5_command_issued, &S3_connected, Evt_ack, &on_ack);
   fsm.add_transition(&S3_connected, &S3_connected, Evt_response, &on_data);
   fsm.add_transition(&S3_connected, &S3_connected, Evt_load, &on_load);
   fsm.add_transition(&S3_connected, &S10_running, Evt_run, &on_run);
@@ -379,10 +1193,11 @@ void setFsm() {
   fsm.add_transition(&S10_running, &S3_connected, Evt_stop, &on_stop);
 
   fsm.add_transition(&S10_running, &S11_running_command_queued, Evt_command, NULL);
-  fsm.add_transition(&S11_running_command_queued, &S12_running_command_issued, Evt_data, &on_command);
-  fsm.add_transition(&S11_running_command_queued, &S12_running_command_issued, Evt_response, &on_command);
-  fsm.add_timed_transition(&S12_running_command_issued, &S11_running_command_queued, 3000, &on_command);
-  fsm.add_transition(&S12_running_command_issued, &S13_running_active, Evt_response, &on_inject_data);
+  fsm.add_transition(&S11_running_command_queued, &S12_running_command_issued, Evt_tx_window, &on_command);
+  fsm.add_transition(&S12_running_command_issued, &S11_running_command_queued, Evt_timeout, &on_retry);
+  fsm.add_transition(&S12_running_command_issued, &S13_running_active, Evt_ack, &on_inject_ack);
+  fsm.add_transition(&S11_running_command_queued, &S3_connected, Evt_stop, &on_stop);
+  fsm.add_transition(&S12_running_command_issued, &S3_connected, Evt_stop, &on_stop);
 
   fsm.add_transition(&S10_running, &S3_connected, Evt_end, NULL);
   fsm.add_transition(&S11_running_command_queued, &S4_command_queued, Evt_end, NULL);
@@ -394,10 +1209,11 @@ void setFsm() {
   fsm.add_transition(&S13_running_active, &S6_disconnect_queued, Evt_disconnect, &on_stop); // this can trigger a stop command
 
   fsm.add_transition(&S13_running_active, &S14_running_active_command_queued, Evt_command, NULL);
-  fsm.add_transition(&S14_running_active_command_queued, &S15_running_active_command_issued, Evt_data, &on_command);
-  fsm.add_transition(&S14_running_active_command_queued, &S15_running_active_command_issued, Evt_response, &on_command);
-  fsm.add_timed_transition(&S15_running_active_command_issued, &S14_running_active_command_queued, 3000, &on_command);
-  fsm.add_transition(&S15_running_active_command_issued, &S13_running_active, Evt_response, &on_inject_data);
+  fsm.add_transition(&S14_running_active_command_queued, &S15_running_active_command_issued, Evt_tx_window, &on_command);
+  fsm.add_transition(&S15_running_active_command_issued, &S14_running_active_command_queued, Evt_timeout, &on_retry);
+  fsm.add_transition(&S15_running_active_command_issued, &S13_running_active, Evt_ack, &on_inject_ack);
+  fsm.add_transition(&S14_running_active_command_queued, &S3_connected, Evt_stop, &on_stop);
+  fsm.add_transition(&S15_running_active_command_issued, &S3_connected, Evt_stop, &on_stop);
   
   fsm.add_transition(&S13_running_active, &S3_connected, Evt_end, NULL);
   fsm.add_transition(&S14_running_active_command_queued, &S4_command_queued, Evt_end, NULL);
@@ -407,19 +1223,134 @@ void setFsm() {
   fsm.add_transition(&S3_connected, &S3_connected, Evt_end, NULL);
   fsm.add_transition(&S3_connected, &S6_disconnect_queued, Evt_disconnect, &on_stop); // this can trigger a stop command
   fsm.add_transition(&S6_disconnect_queued, &S7_disconnecting, Evt_response, &on_disconnect);
-  fsm.add_transition(&S6_disconnect_queued, &S6_disconnect_queued, Evt_command, &on_command); // we have to handle the stop command
-  fsm.add_timed_transition(&S7_disconnecting, &S0_disconnected, 3000, NULL);
+  fsm.add_transition(&S6_disconnect_queued, &S7_disconnecting, Evt_ack, &on_disconnect);
+  fsm.add_transition(&S6_disconnect_queued, &S6_disconnect_queued, Evt_command, &on_command); // we have to handle a command queued before (the stop takes the fast path)
+  fsm.add_transition(&S7_disconnecting, &S0_disconnected, Evt_state_timeout, NULL);
   fsm.add_transition(&S7_disconnecting, &S7_disconnecting, Evt_response, &on_disconnect);
 
   // FSM on load only operation
   fsm.add_transition(&S0_disconnected, &S2_connecting_load, Evt_load, &on_connect);
-  fsm.add_timed_transition(&S2_connecting_load, &S2_connecting_load, 3000, &on_connect);
+  fsm.add_transition(&S2_connecting_load, &S2_connecting_load, Evt_state_timeout, &on_connect);
   fsm.add_transition(&S2_connecting_load, &S7_disconnecting, Evt_response, &on_disconnect);
+
+  // enter the initial state, the fsm ignores all events before. the loop runs from reset on,
+  // so Evt_init is never missed and SX_null needs no timeout.
+  // there are no timed transitions and no state functions, so run_machine() is never polled.
+  fsm.run_machine();
+}
+
+
+// a periodic handler arms itself again, a refused timer would stop it for good
+void rearm(unsigned long ms, TimerWheel::Handler handler, const char* name) {
+  if (timers.In(ms, handler) == TimerWheel::InvalidTimer) {
+    DLOGE("no timer left, %s stopped", name);
+  }
+}
+
+void onPowerReport(void *) {
+  StackString<128> json;
+  power.WriteStatsJson(json);
+  esp.setProperty("power").send(json.c_str());
+  rearm(POWER_REPORT_MS, onPowerReport, "power report");
+}
+
+void onMetricsReport(void *) {
+  if (mqttReady) {
+    // one buffer for all reports, each is published before the next is written
+    StackString<512> json;
+    health.WriteStatsJson(json, timers.Now());
+    metrics.setProperty("health").send(json.c_str());
+    json.Clear();
+    CommandTracer::GetInstance().WriteStatsJson(json, commandQueue);
+    metrics.setProperty("commands").send(json.c_str());
+    json.Clear();
+    writeTelemetrySuppressedJson(json);
+    metrics.setProperty("telemetry").send(json.c_str());
+    json.Clear();
+    outbox.WriteStatsJson(json);
+    metrics.setProperty("outbox").send(json.c_str());
+  }
+  rearm(metricsInterval.get() * 1000UL, onMetricsReport, "metrics report");
 }
 
+// one record per interval instead of a message per property, only if a frame was received since the last one.
+// a skipped repeated frame counts as well, its values are the ones of the last decoded frame
+void onTelemetryRecord(void *) {
+  if (lastFrameValid && (lastRecordFrame != frameClock.GetLastFrame())
+    && telemetryRecord.Build(timers.Now(), controller->ModeAsString(), processor.GetStep(), store.GetParameters())) {
+    uint16_t packetId = 0;
+    if (mqttReady) {
+      PROFILE_SCOPE(Prof_Publish);
+      packetId = Homie.getMqttClient().publish(telemetryRecord.GetTopic(), 1, true,
+        telemetryRecord.GetRecord(), telemetryRecord.GetLength());
+      health.OnPublish(packetId != 0);
+    }
+    if (packetId == 0) {
+      outboxAdd(Outbox::Kind_Telemetry, "controller", "telemetry", telemetryRecord.GetRecord());
+    }
+    lastRecordFrame = frameClock.GetLastFrame();
+  }
+  rearm(telemetryInterval.get() * 1000UL, onTelemetryRecord, "telemetry record");
+}
+
+// publishes the captured frames, a message holds as many frames as fit into the buffer
+void flushCapture() {
+  static uint8_t data[768];
+  while (mqttReady && (0 < rawCapture.GetCount())) {
+    size_t len = rawCapture.Write(data, sizeof(data));
+    if (len == 0) {
+      break;
+    }
+    PROFILE_SCOPE(Prof_Publish);
+    uint16_t packetId = Homie.getMqttClient().publish(captureTopic, 1, false, (const char*)data, len);
+    health.OnPublish(packetId != 0);
+  }
+}
+
+void onLogFlush(void *) {
+  if (mqttReady) {
+    Logger::GetInstance().Flush();
+  }
+  rearm(LOG_FLUSH_MS, onLogFlush, "log flush");
+}
+
+// a disconnected charger is silent: ask it to connect until it talks, mqtt is ready or
+// the attempts are used up. after that it is connected by the user as usual.
+void onChargerProbe(void *) {
+  static uint8_t attempts = 0;
+  if (mqttReady || frameClock.HasFrame() || (PROBE_ATTEMPTS <= attempts)) {
+    return;
+  }
+  attempts++;
+  DLOGD("no frame of a charger yet, connect probe %u", (unsigned)attempts);
+  send(EbcController::GetController().CreateConnect());
+  rearm(PROBE_INTERVAL_MS, onChargerProbe, "charger probe");
+}
+
+void onCaptureFlush(void *) {
+  flushCapture();
+  rearm(CAPTURE_FLUSH_MS, onCaptureFlush, "capture flush");
+}
 
-// called by Homie if normal operation mode enters
-void normalModeSetup() {
+#ifdef EBC_PROFILER
+// publishes the histograms of the last period and starts a new one
+void onProfileReport(void *) {
+  static char json[1024];
+  if (mqttReady && (0 < Profiler::GetInstance().WriteJson(json, sizeof(json)))) {
+    stats.setProperty("profile").send(json);
+  }
+  Profiler::GetInstance().Reset();
+  rearm(PROFILE_REPORT_MS, onProfileReport, "profile report");
+}
+#endif
+
+// wakes the main loop
+bool workPending() {
+  return (0 < ebcSerial.available()) || !eventQueue.empty();
+}
+
+// called on reset, the uart is read while wifi and mqtt come up
+void gatewaySetup() {
 
   Serial.begin(9600);
 #ifdef ESP8266
@@ -432,35 +1363,111 @@ void normalModeSetup() {
   processor.SetCommmander(cpuCommandHandler);
   processor.SetReportHandler(cpuReportHandler);
   processor.SetEventHandler(cpuEventHandler);
+  processor.SetStopHandler(cpuStopHandler);
+  power.Begin();
+  timers.In(POWER_REPORT_MS, onPowerReport);
+  timers.In(LOG_FLUSH_MS, onLogFlush);
+  timers.In(PROBE_INTERVAL_MS, onChargerProbe);
+#ifdef EBC_PROFILER
+  timers.In(PROFILE_REPORT_MS, onProfileReport);
+#endif
 }
 
-// called periodically by Homie in normal operation mode
-void normalModeLoop() {
+// called periodically by the arduino loop, also while wifi and mqtt are not ready
+// (Homie would call its loop function only while mqtt is connected)
+void gatewayLoop() {
+  health.OnLoop();
   readFromController();
-  if (!eventQueue.empty()) {
-    fsm.trigger(eventQueue.front());
+  assertStop();
+  scheduleController();
+  // handle all pending events at once, so a command is issued in the same gap the frame has opened
+  for (int n = 0; (n < 16) && !eventQueue.empty(); ++n) {
+    health.OnEventQueue(eventQueue.size());
+    {
+      PROFILE_SCOPE(Prof_Fsm);
+      if (eventQueue.front() == Evt_settings) {
+        applySettings();
+      } else {
+        fsm.trigger(eventQueue.front());
+      }
+    }
     eventQueue.pop();
   }
-  fsm.run_machine();
-  processor.Tick();
+  if (rawCapture.IsBatchReady()) {
+    flushCapture();
+  }
+  timers.Tick();
+  // nothing left to do: sleep until uart data, an mqtt event or the next deadline
+  if (eventQueue.empty()) {
+    power.Wait(timers.TimeToNext(), workPending);
+  }
+  // all transient buffers of this iteration are gone
+  FrameArena::GetInstance().Reset();
 }
 
 
 void setup() {
+  gatewaySetup();
+
   Homie_setFirmware(firmwareName, firmwareVersion);
-  Homie.setSetupFunction(normalModeSetup);
-  Homie.setLoopFunction(normalModeLoop);
   // Homie.disableLedFeedback();
   Homie.disableLogging();
 
   advertise();
   setFsm();
 
+  metricsInterval.setDefaultValue(60).setValidator([] (long candidate) {
+    return (0 <= candidate) && (candidate <= 86400);
+  });
+  publishKeepAlive.setDefaultValue(300).setValidator([] (long candidate) {
+    return (0 <= candidate) && (candidate <= 86400);
+  });
+  telemetryInterval.setDefaultValue(0).setValidator([] (long candidate) {
+    return (0 <= candidate) && (candidate <= 3600);
+  });
+  propertyTopics.setDefaultValue(true);
+  binaryPayloads.setDefaultValue(false);
+  captureBatch.setDefaultValue(0).setValidator([] (long candidate) {
+    return (0 <= candidate) && (candidate <= (long)RawCapture::MAX_FRAMES);
+  });
+  captureHex.setDefaultValue(false);
+  logLevel.setDefaultValue(0).setValidator([] (long candidate) {
+    return (Logger::Debug <= candidate) && (candidate <= Logger::None);
+  });
+  outboxSpill.setDefaultValue(64).setValidator([] (long candidate) {
+    return (0 <= candidate) && (candidate <= 1024);
+  });
+  frameRefresh.setDefaultValue(10).setValidator([] (long candidate) {
+    return (0 <= candidate) && (candidate <= 3600);
+  });
+
   Homie.onEvent(onHomieEvent);
   Homie.setup();
+
+  // the settings are loaded by Homie.setup()
+  publishCache.SetKeepAlive(publishKeepAlive.get() * 1000UL);
+  Logger::GetInstance().SetLevel((Logger::LogSeverity)logLevel.get());
+  outbox.Begin(OUTBOX_FILE, outboxSpill.get() * 1024UL);
+  if (telemetryPolicy.wasProvided()) {
+    applyTelemetryPolicy(telemetryPolicy.get());
+  }
+  if (0 < telemetryInterval.get()) {
+    telemetryRecord.SetTopic(Homie.getConfiguration().mqtt.baseTopic, Homie.getConfiguration().deviceId, "controller", "telemetry");
+    timers.In(telemetryInterval.get() * 1000UL, onTelemetryRecord);
+  }
+  if (0 < metricsInterval.get()) {
+    timers.In(metricsInterval.get() * 1000UL, onMetricsReport);
+  }
+  if (0 < captureBatch.get()) {
+    snprintf(captureTopic, sizeof(captureTopic), "%s%s/raw/capture", Homie.getConfiguration().mqtt.baseTopic, Homie.getConfiguration().deviceId);
+    rawCapture.SetHex(captureHex.get());
+    rawCapture.SetBatch(captureBatch.get());
+    timers.In(CAPTURE_FLUSH_MS, onCaptureFlush);
+  }
 }
 
 void loop() {
   Homie.loop();
+  gatewayLoop();
 }
 
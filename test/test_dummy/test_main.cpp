@@ -18,6 +18,16 @@
 #include <unity.h>
 
 #include "command.hpp"
+#include "CommandQueue.hpp"
+#include "EbcController.hpp"
+#include "TimerWheel.hpp"
+#include "PublishCache.hpp"
+#include "StringBuilder.hpp"
+#include "Outbox.hpp"
+#include "FrameArena.hpp"
+#include "TelemetryPolicy.hpp"
+#include "TelemetryRate.hpp"
+#include "LogRing.hpp"
 
 void setUp(void) {}
 void tearDown(void) {}
@@ -35,11 +45,462 @@ void test_commands(void)
   TEST_ASSERT_EQUAL_STRING("fa21006401b4000a0af8", Command::CreateChargeCV(4.2, 1.0, 0.1).ToString().c_str());
 }
 
+void test_command_queue(void)
+{
+  EbcController& c = EbcController::GetController(0x09);
+  std::vector<Parameter> p = c.GetCommandParameters(c.GetCommand("C-CV"));
+  CommandFrame charge = c.CreateCommand(c.GetCommand("C-CV"), p).GetFrame();
+  CommandFrame stop = c.CreateStop().GetFrame();
+  CommandQueue q;
+  CommandFrame out;
+
+  // the frame holds the bytes as they are sent
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(c.CreateStop().GetData(), stop.bytes, CommandFrame::LENGTH);
+
+  // stop is delivered first, the start keeps its place behind it
+  TEST_ASSERT_TRUE(q.Push(stop, CommandQueue::Priority_Stop));
+  TEST_ASSERT_TRUE(q.Push(charge, CommandQueue::Priority_Start));
+  TEST_ASSERT_TRUE(q.Push(charge, CommandQueue::Priority_SetPoint));
+  TEST_ASSERT_EQUAL(2, q.Size());
+  TEST_ASSERT_EQUAL(1, q.GetMerged());
+  TEST_ASSERT_TRUE(q.Pop(out));
+  TEST_ASSERT_TRUE(c.IsStopCommand(out.GetCommand()));
+  TEST_ASSERT_TRUE(q.Pop(out));
+  TEST_ASSERT_EQUAL(charge.GetCommand(), out.GetCommand());
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(charge.bytes, out.bytes, CommandFrame::LENGTH);
+
+  // a stop supersedes a queued start
+  TEST_ASSERT_TRUE(q.Push(charge, CommandQueue::Priority_Start));
+  TEST_ASSERT_TRUE(q.Push(stop, CommandQueue::Priority_Stop));
+  TEST_ASSERT_EQUAL(1, q.Size());
+  TEST_ASSERT_EQUAL(1, q.GetDropped());
+
+  // the counters published in metrics/commands
+  StackString<96> json;
+  q.WriteStatsJson(json);
+  TEST_ASSERT_EQUAL_STRING("{\"pushed\":5,\"merged\":1,\"dropped\":1,\"highWater\":2}", json.c_str());
+}
+
+static unsigned long fakeTime = 0;
+static unsigned long fakeClock() { return fakeTime; }
+static void countTimer(void *arg) { (*(int*)arg)++; }
+
+void test_timer_wheel(void)
+{
+  TimerWheel w(fakeClock);
+  int fired = 0;
+  int canceled = 0;
+
+  w.In(100, countTimer, &fired);
+  w.In(3600000UL, countTimer, &fired); // beyond the wheel, parked and cascaded
+  TimerWheel::TimerId id = w.In(50, countTimer, &canceled);
+  TEST_ASSERT_TRUE(w.Cancel(id));
+  TEST_ASSERT_FALSE(w.IsPending(id));
+  TEST_ASSERT_EQUAL(100, w.TimeToNext());
+
+  fakeTime = 99; w.Tick();
+  TEST_ASSERT_EQUAL(0, fired); // never early
+  fakeTime = 120; w.Tick();
+  TEST_ASSERT_EQUAL(1, fired);
+
+  for (fakeTime = 120; fakeTime < 3600000UL; fakeTime += 1000) {
+    w.Tick();
+  }
+  TEST_ASSERT_EQUAL(1, fired);
+  fakeTime = 3600020UL; w.Tick();
+  TEST_ASSERT_EQUAL(2, fired);
+  TEST_ASSERT_EQUAL(0, canceled);
+  TEST_ASSERT_EQUAL(TimerWheel::NoDeadline, w.TimeToNext());
+
+  // an id stays valid over all generations of all timers
+  TimerWheel::TimerId ids[TimerWheel::MAX_TIMERS];
+  for (size_t i = 0; i < TimerWheel::MAX_TIMERS; i++) {
+    ids[i] = w.In(10, countTimer, &canceled);
+    TEST_ASSERT_NOT_EQUAL(TimerWheel::InvalidTimer, ids[i]);
+  }
+  for (long g = 0; g < 0x1000; g++) {
+    TEST_ASSERT_TRUE(w.Cancel(ids[TimerWheel::MAX_TIMERS - 1]));
+    ids[TimerWheel::MAX_TIMERS - 1] = w.In(10, countTimer, &canceled);
+    TEST_ASSERT_NOT_EQUAL(TimerWheel::InvalidTimer, ids[TimerWheel::MAX_TIMERS - 1]);
+  }
+
+  // a full pool is refused and counted
+  TEST_ASSERT_EQUAL(TimerWheel::InvalidTimer, w.In(10, countTimer, &canceled));
+  TEST_ASSERT_EQUAL(1, w.GetFailures());
+  TEST_ASSERT_EQUAL(TimerWheel::MAX_TIMERS, w.GetHighWater());
+  w.CancelAll(&canceled);
+}
+
+void test_publish_cache(void)
+{
+  PublishCache c;
+  c.SetKeepAlive(1000);
+  TEST_ASSERT_TRUE(c.Check("controller", "mode", "CC", 0));
+  TEST_ASSERT_FALSE(c.Check("controller", "mode", "CC", 10));
+  TEST_ASSERT_TRUE(c.Check("cpu", "mode", "CC", 10)); // other node
+  TEST_ASSERT_TRUE(c.Check("controller", "mode", "CV", 20));
+  TEST_ASSERT_FALSE(c.Check("controller", "mode", "CV", 1019));
+  TEST_ASSERT_TRUE(c.Check("controller", "mode", "CV", 1020)); // keep-alive
+  c.Forget("controller", "mode");
+  TEST_ASSERT_TRUE(c.Check("controller", "mode", "CV", 1030));
+}
+
+void test_string_builder(void)
+{
+  StackString<32> s;
+  s << F("step ") << 3 << ' ' << -12L << ' ';
+  s.AddFixed(4.0126, 3).Add(' ').AddFixed(-0.5, 3).Add(' ').AddMilli(-1999, 2);
+  TEST_ASSERT_EQUAL_STRING("step 3 -12 4.013 -0.500 -2.00", s.c_str());
+  TEST_ASSERT_FALSE(s.IsTruncated());
+
+  StackString<8> t;
+  t << "0123456789";
+  TEST_ASSERT_EQUAL_STRING("0123456", t.c_str());
+  TEST_ASSERT_TRUE(t.IsTruncated());
+}
+
+// the bytes of a frame, read like from the uart
+class BufferStream : public Stream
+{
+  public:
+    BufferStream(const uint8_t* d, size_t n) : data(d), len(n), pos(0) {}
+    int available() override { return len - pos; }
+    int read() override { return (pos < len) ? data[pos++] : -1; }
+    int peek() override { return (pos < len) ? data[pos] : -1; }
+    size_t write(uint8_t) override { return 0; }
+    void flush() {}
+  private:
+    const uint8_t* data;
+    size_t len;
+    size_t pos;
+};
+
+// an EBC-A20 response frame, the values are base 240 numbers
+static EbcController& readResponse(Response& response, uint8_t mode, const uint16_t values[Response::DATA_VALUES_LEN])
+{
+  uint8_t frame[19] = { 0xfa, mode };
+  for (size_t i = 0; i < Response::DATA_VALUES_LEN; ++i) {
+    frame[2 + 2 * i] = values[i] >> 8;
+    frame[3 + 2 * i] = values[i] & 0xff;
+  }
+  frame[16] = 0x09;
+  for (size_t i = 1; i < 17; ++i) {
+    frame[17] ^= frame[i];
+  }
+  frame[18] = 0xf8;
+  BufferStream stream(frame, sizeof(frame));
+  TEST_ASSERT_TRUE(response.Read(stream));
+  return EbcController::GetController(response);
+}
+
+// the json of ArduinoJson, as GetResponseJson() built it before WriteResponseJson()
+static String referenceJson(const EbcController& c)
+{
+  StaticJsonDocument<256> doc;
+  JsonObject root = doc.to<JsonObject>();
+  root["mode"] = c.ModeAsString();
+  JsonObject parameters = root["parameters"].to<JsonObject>();
+  for (auto& p : c.GetResponseParameters()) {
+    if (p.packing != PP_None) {
+      parameters[p.name] = p.value;
+    }
+  }
+  String output;
+  serializeJson(doc, output);
+  return output;
+}
+
+void test_response_writers(void)
+{
+  static const uint8_t modes[] = { 0x0a, 0x00, 0x14, 0x0b, 0x01, 0x15, 0x0c, 0x02, 0x16, 0x6e };
+  static const uint16_t values[][Response::DATA_VALUES_LEN] = {
+    { 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000 },
+    { 0x0164, 0x1010, 0x0023, 0x0000, 0x0064, 0x01a4, 0x000a },
+    { 0x8312, 0x0a0b, 0x8345, 0x0000, 0x0101, 0x1001, 0x0078 },   // capacity from 10 Ah
+    { 0x0000, 0x0001, 0xe105, 0x0000, 0x0000, 0x0000, 0x0000 },   // capacity from 200 Ah
+    { 0xefef, 0xefef, 0xefef, 0xefef, 0xefef, 0xefef, 0xefef },   // the longest values
+  };
+  char json[256];
+  uint8_t data[160];
+
+  for (auto mode : modes) {
+    for (auto& v : values) {
+      Response response;
+      EbcController& c = readResponse(response, mode, v);
+      String expected = referenceJson(c);
+
+      size_t n = c.WriteResponseJson(json, sizeof(json));
+      TEST_ASSERT_TRUE(0 < n);
+      TEST_ASSERT_EQUAL(strlen(json), n);
+      TEST_ASSERT_EQUAL_STRING(expected.c_str(), json);
+      TEST_ASSERT_EQUAL_STRING(expected.c_str(), c.GetResponseJson().c_str());
+
+      // the smallest buffer that is accepted holds the text and the terminator
+      size_t smallest = 0;
+      for (size_t len = 1; (len <= sizeof(json)) && (smallest == 0); ++len) {
+        if (0 < c.WriteResponseJson(json, len)) {
+          smallest = len;
+        }
+      }
+      TEST_ASSERT_TRUE(n < smallest);
+      TEST_ASSERT_EQUAL_STRING(expected.c_str(), json);
+
+      // the MessagePack has the same content
+      size_t len = c.WriteResponseMsgPack(data, sizeof(data));
+      TEST_ASSERT_TRUE(0 < len);
+      StaticJsonDocument<384> doc;
+      TEST_ASSERT_TRUE(deserializeMsgPack(doc, (const char*)data, len) == DeserializationError::Ok);
+      TEST_ASSERT_EQUAL_STRING(c.ModeAsString(), doc["mode"].as<const char*>());
+      JsonObject parameters = doc["parameters"];
+      size_t num = 0;
+      for (auto& p : c.GetResponseParameters()) {
+        if (p.packing != PP_None) {
+          TEST_ASSERT_TRUE(parameters.containsKey(p.name));
+          TEST_ASSERT_FLOAT_WITHIN(0.001, p.value, parameters[p.name].as<float>());
+          num++;
+        }
+      }
+      TEST_ASSERT_EQUAL(num, parameters.size());
+      TEST_ASSERT_EQUAL(0, c.WriteResponseMsgPack(data, 4));
+    }
+  }
+}
+
+static char publishedText[128];
+static StringBuilder published(publishedText, sizeof(publishedText));
+static uint32_t publishedResults = 0;
+static bool publishedInOrder = true;
+
+// "topic=value " for each message, a retained one is marked by '*'
+static bool logPublish(const char* topic, const char* value, bool retained)
+{
+  published << topic << '=' << value << (retained ? "* " : " ");
+  if (retained) {
+    publishedResults++;
+  }
+  return true;
+}
+
+// the values are the numbers 0, 1, 2, ...
+static bool orderedPublish(const char* topic, const char* value, bool retained)
+{
+  if (atol(value) != (long)publishedResults) {
+    publishedInOrder = false;
+  }
+  publishedResults++;
+  return true;
+}
+
+void test_outbox(void)
+{
+  Outbox* o = new Outbox();    // the ram buffer is too large for the stack
+  char property[8];
+  char value[48];
+  memset(value, 'x', sizeof(value) - 1);
+  value[sizeof(value) - 1] = '\0';
+
+  // ram only: the order is kept, a newer result replaces the queued one
+  TEST_ASSERT_FALSE(o->Begin(nullptr, 0));
+  TEST_ASSERT_TRUE(o->Add(Outbox::Kind_Result, "cpu", "result", "[1]", 0));
+  TEST_ASSERT_TRUE(o->Add(Outbox::Kind_Telemetry, "controller", "voltageV", "4.1", 0));
+  TEST_ASSERT_TRUE(o->Add(Outbox::Kind_Result, "cpu", "state", "running", 0));
+  TEST_ASSERT_TRUE(o->Add(Outbox::Kind_Result, "cpu", "result", "[1,2]", 0));
+  TEST_ASSERT_EQUAL(3, o->Flush(logPublish, 8, 1024));
+  TEST_ASSERT_EQUAL_STRING("controller/voltageV=4.1 cpu/state=running* cpu/result=[1,2]* ", published.c_str());
+  TEST_ASSERT_TRUE(o->IsEmpty());
+
+  // the telemetry is dropped from three quarters full on, the rest is left to the results
+  unsigned long now = 0;
+  for (int i = 0; o->GetPressure() < 3; ++i) {
+    snprintf(property, sizeof(property), "t%d", i);
+    TEST_ASSERT_TRUE(o->Add(Outbox::Kind_Telemetry, "controller", property, value, now));
+    now += 60000;   // beyond the downsampling
+  }
+  uint32_t dropped = o->GetDropped();
+  TEST_ASSERT_FALSE(o->Add(Outbox::Kind_Telemetry, "controller", "next", value, now));
+  TEST_ASSERT_EQUAL(dropped + 1, o->GetDropped());
+
+  // without flash a result takes the room of the telemetry
+  const int results = Outbox::RAM_SIZE / 80;
+  for (int i = 0; i < results; ++i) {
+    snprintf(property, sizeof(property), "r%d", i);
+    TEST_ASSERT_TRUE(o->Add(Outbox::Kind_Result, "cpu", property, value, now));
+  }
+  TEST_ASSERT_TRUE(dropped + 1 < o->GetDropped());
+  publishedResults = 0;
+  published.Clear();
+  while (!o->IsEmpty()) {
+    o->Flush(logPublish, 8, 1024);
+    published.Clear();
+  }
+  TEST_ASSERT_EQUAL(results, publishedResults);
+  delete o;
+
+  // with flash: the spill file is published before the ram, in the order of Add()
+  o = new Outbox();
+  if (o->Begin("/outbox_test.bin", 8192)) {
+    const int n = 400;    // more than the ram holds
+    for (int i = 0; i < n; ++i) {
+      snprintf(property, sizeof(property), "r%d", i);
+      snprintf(value, sizeof(value), "%d", i);
+      TEST_ASSERT_TRUE(o->Add(Outbox::Kind_Result, "cpu", property, value, 0));
+    }
+    TEST_ASSERT_TRUE(0 < o->GetSpilled());
+    publishedResults = 0;
+    while (!o->IsEmpty()) {
+      o->Flush(orderedPublish, 8, 1024);
+      FrameArena::GetInstance().Reset();
+    }
+    TEST_ASSERT_EQUAL(n, publishedResults);
+    TEST_ASSERT_TRUE(publishedInOrder);
+  } else {
+    TEST_MESSAGE("no file system, the spill file is not tested");
+  }
+  delete o;
+}
+
+void test_telemetry_policy(void)
+{
+  TelemetryPolicy p(5, 0, 1000, 10000, 60000);
+  TEST_ASSERT_TRUE(p.Check(4000, 0));           // the first value
+  TEST_ASSERT_FALSE(p.Check(4100, 500));        // within the min interval
+  TEST_ASSERT_FALSE(p.Check(4005, 1500));       // within the deadband
+  TEST_ASSERT_TRUE(p.Check(4006, 1600));
+  TEST_ASSERT_FALSE(p.Check(4100, 3000, false)); // the slow interval at the low rate
+  TEST_ASSERT_TRUE(p.Check(4100, 11600, false));
+  TEST_ASSERT_FALSE(p.Check(4100, 70000));
+  TEST_ASSERT_TRUE(p.Check(4100, 71600));       // heartbeat after the max interval
+  TEST_ASSERT_EQUAL(3, p.GetSuppressed());
+  p.Reset();
+  TEST_ASSERT_TRUE(p.Check(4100, 71601));
+
+  // 10 permille of the last value
+  TelemetryPolicy relative(0, 10, 0, 0, 0);
+  TEST_ASSERT_TRUE(relative.Check(10000, 0));
+  TEST_ASSERT_FALSE(relative.Check(10100, 1));
+  TEST_ASSERT_TRUE(relative.Check(10101, 2));
+
+  StaticJsonDocument<128> doc;
+  deserializeJson(doc, "{\"deadband\":20,\"minMs\":1000,\"maxMs\":500}");
+  TEST_ASSERT_FALSE(p.SetFromJson(doc.as<JsonVariantConst>()));   // max below min
+  TEST_ASSERT_EQUAL(5, p.Get().deadband);
+  deserializeJson(doc, "{\"deadband\":20}");
+  TEST_ASSERT_TRUE(p.SetFromJson(doc.as<JsonVariantConst>()));
+  TEST_ASSERT_EQUAL(20, p.Get().deadband);
+  TEST_ASSERT_EQUAL(1000, p.Get().minInterval);
+
+  // full rate after an event and near a threshold
+  TelemetryRate rate(30000, 50);
+  TEST_ASSERT_FALSE(rate.IsFast(0, 4000));
+  rate.OnEvent(1000);
+  TEST_ASSERT_TRUE(rate.IsFast(30999, 4000));
+  TEST_ASSERT_FALSE(rate.IsFast(31000, 4000));
+  int32_t thresholds[] = { 4200, 0 };   // 0 is no threshold
+  rate.SetThresholds(thresholds, 2);
+  TEST_ASSERT_TRUE(rate.IsFast(40000, 4150));
+  TEST_ASSERT_TRUE(rate.IsFast(40000, 4250));
+  TEST_ASSERT_FALSE(rate.IsFast(40000, 4149));
+  TEST_ASSERT_FALSE(rate.IsFast(40000, 0));
+  rate.ClearThresholds();
+  TEST_ASSERT_FALSE(rate.IsFast(40000, 4200));
+}
+
+static char sinkText[4][LogRing::MAX_BATCH_LEN];
+static uint8_t sinkSeverity[4];
+static size_t sinkCalls = 0;
+
+static void recordSink(uint8_t severity, const char* text)
+{
+  if (sinkCalls < 4) {
+    sinkSeverity[sinkCalls] = severity;
+    strncpy(sinkText[sinkCalls], text, LogRing::MAX_BATCH_LEN - 1);
+  }
+  sinkCalls++;
+}
+
+static const char frameFormat[] PROGMEM = "frame %u of %s";
+static const char crcFormat[] PROGMEM = "crc 0x%02x, %d%%";
+static const char lostFormat[] PROGMEM = "link lost for %lu ms";
+static const char voltageFormat[] PROGMEM = "%.3f V, %f";
+static const char crcFailFormat[] PROGMEM = "crc check failed: 0x%x != 0x%x";
+static char longFormats[LogRing::MAX_ENTRIES + 2][64];  // distinct formats with the same text
+
+void test_log_ring(void)
+{
+  LogRing ring;
+
+  // a repeated format is counted with the latest arguments, not recorded again
+  ring.Add(1, frameFormat, 3u, "capture", LogArg());
+  ring.Add(1, frameFormat, 3u, "capture", LogArg());
+  ring.Add(1, frameFormat, 4u, "capture", LogArg());
+  ring.Add(1, crcFormat, 0x0au, -5, LogArg());
+  ring.Add(2, lostFormat, 1200ul, LogArg(), LogArg());
+  ring.Add(2, voltageFormat, 4.2, -0.5f, LogArg());
+  TEST_ASSERT_EQUAL(4, ring.GetCount());
+
+  // one batch per severity
+  sinkCalls = 0;
+  ring.Flush(recordSink, 0);
+  TEST_ASSERT_EQUAL(2, sinkCalls);
+  TEST_ASSERT_EQUAL(1, sinkSeverity[0]);
+  TEST_ASSERT_EQUAL_STRING("frame 4 of capture (3 times)\ncrc 0x0a, -5%", sinkText[0]);
+  TEST_ASSERT_EQUAL(2, sinkSeverity[1]);
+  TEST_ASSERT_EQUAL_STRING("link lost for 1200 ms\n4.200 V, -0.500000", sinkText[1]);
+  TEST_ASSERT_EQUAL(0, ring.GetCount());
+
+  // crc failures with other checksums collapse into one message
+  for (unsigned i = 0; i < 5; ++i) {
+    ring.Add(2, crcFailFormat, 0x30u + i, 0x50u + i, LogArg());
+  }
+  TEST_ASSERT_EQUAL(1, ring.GetCount());
+  sinkCalls = 0;
+  ring.Flush(recordSink, 1000);
+  TEST_ASSERT_EQUAL(1, sinkCalls);
+  TEST_ASSERT_EQUAL_STRING("crc check failed: 0x34 != 0x54 (5 times)", sinkText[0]);
+
+  // within the rate limit the format stays pending and keeps counting
+  ring.Add(2, crcFailFormat, 0x3au, 0x5cu, LogArg());
+  ring.Add(2, crcFailFormat, 0x3bu, 0x5du, LogArg());
+  sinkCalls = 0;
+  ring.Flush(recordSink, 1000 + LogRing::RATE_LIMIT_MS - 1);
+  TEST_ASSERT_EQUAL(0, sinkCalls);
+  TEST_ASSERT_EQUAL(1, ring.GetCount());
+  ring.Add(2, crcFailFormat, 0x3cu, 0x5eu, LogArg());
+  ring.Flush(recordSink, 1000 + LogRing::RATE_LIMIT_MS);
+  TEST_ASSERT_EQUAL(1, sinkCalls);
+  TEST_ASSERT_EQUAL_STRING("crc check failed: 0x3c != 0x5e (3 times)", sinkText[0]);
+  TEST_ASSERT_EQUAL(0, ring.GetCount());
+
+  // the oldest messages are dropped, a batch never exceeds MAX_BATCH_LEN
+  for (int i = 0; i < (int)LogRing::MAX_ENTRIES + 2; ++i) {
+    strcpy(longFormats[i], "a message long enough to fill the batch quickly: %d");
+    ring.Add(1, longFormats[i], i, LogArg(), LogArg());
+  }
+  TEST_ASSERT_EQUAL(LogRing::MAX_ENTRIES, ring.GetCount());
+  TEST_ASSERT_EQUAL(2, ring.GetDropped());
+  sinkCalls = 0;
+  ring.Flush(recordSink, 0);
+  TEST_ASSERT_TRUE(1 < sinkCalls);
+  const char* first = "a message long enough to fill the batch quickly: 2\n";
+  TEST_ASSERT_EQUAL(0, strncmp(first, sinkText[0], strlen(first)));
+  for (size_t i = 0; (i < sinkCalls) && (i < 4); ++i) {
+    TEST_ASSERT_TRUE(strlen(sinkText[i]) < LogRing::MAX_BATCH_LEN);
+  }
+}
+
 // int main()
 // {
 //     UNITY_BEGIN();
 //     RUN_TEST(test_dummy);
 //     RUN_TEST(test_commands);
+//     RUN_TEST(test_command_queue);
+//     RUN_TEST(test_timer_wheel);
+//     RUN_TEST(test_publish_cache);
+//     RUN_TEST(test_string_builder);
+//     RUN_TEST(test_response_writers);
+//     RUN_TEST(test_outbox);
+//     RUN_TEST(test_telemetry_policy);
+//     RUN_TEST(test_log_ring);
 //     UNITY_END(); // stop unit testing
 
 //     while (1)
@@ -53,6 +514,14 @@ void setup()
     UNITY_BEGIN();
     RUN_TEST(test_dummy);
     RUN_TEST(test_commands);
+    RUN_TEST(test_command_queue);
+    RUN_TEST(test_timer_wheel);
+    RUN_TEST(test_publish_cache);
+    RUN_TEST(test_string_builder);
+    RUN_TEST(test_response_writers);
+    RUN_TEST(test_outbox);
+    RUN_TEST(test_telemetry_policy);
+    RUN_TEST(test_log_ring);
     UNITY_END(); // stop unit testing
 }
 